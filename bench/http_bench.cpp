@@ -0,0 +1,644 @@
+// HTTP压测工具：基于EventLoop/Channel的epoll客户端，在本机回环上测量服务器的吞吐量和延迟
+//
+// 用法: http_bench [-c 连接数] [-t 线程数] [-d 秒] [-p 流水线深度] [-r 每秒请求数] [-C] [-u 路径]... [host] [port]
+//   -c  连接总数，平均分配到各线程（默认64）
+//   -t  线程数，每个线程一个EventLoop（默认2）
+//   -d  测试时长，秒（默认10）
+//   -p  每个连接上同时未完成的请求数（默认1，即不使用流水线）
+//   -r  所有连接合计的目标请求速率（默认0，即每个连接收到响应后立即发送下一个请求）
+//   -C  短连接：每个请求新建一个连接（Connection: close），流水线深度固定为1
+//   -u  请求路径，可重复指定，按顺序轮流请求（默认"/"）
+//
+// 指定-r时按固定间隔为每个请求安排计划发送时间，延迟从计划时间开始计算：
+// 服务器变慢时未能按时发出的请求会计入等待时间，避免协调遗漏（coordinated omission）低估尾延迟。
+// 不指定-r时延迟从请求实际发出（或为其建立连接）开始计算。
+#include "event_loop.h"
+#include "channel.h"
+#include "buffer.h"
+#include "inet_address.h"
+#include "metrics.h"
+#include "thread_affinity.h"
+#include "timestamp.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <getopt.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace {
+
+const char kCRLFCRLF[] = "\r\n\r\n";
+
+struct Options {
+    std::string host;
+    uint16_t port;
+    int connections;
+    int threads;
+    double duration;
+    int pipeline;
+    double rate;
+    bool keepAlive;
+    std::vector<std::string> paths;
+
+    Options()
+        : host("127.0.0.1"), port(8888), connections(64), threads(2),
+          duration(10.0), pipeline(1), rate(0.0), keepAlive(true) {}
+};
+
+// 每个线程的统计，结束后合并；延迟直方图沿用Metrics的对数线性分桶
+struct Stats {
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t non2xx;
+    uint64_t connects;
+    uint64_t connectErrors;
+    uint64_t readErrors;
+    uint64_t latencySum;        // 微秒
+    uint64_t latencyMax;
+    std::vector<uint64_t> histogram;
+
+    Stats()
+        : requests(0), bytes(0), non2xx(0), connects(0), connectErrors(0),
+          readErrors(0), latencySum(0), latencyMax(0),
+          histogram(Metrics::kBucketCount, 0) {}
+
+    void record(int64_t latency) {
+        uint64_t value = latency > 0 ? static_cast<uint64_t>(latency) : 0;
+        ++requests;
+        latencySum += value;
+        latencyMax = std::max(latencyMax, value);
+        ++histogram[Metrics::bucketIndex(value)];
+    }
+
+    void merge(const Stats& other) {
+        requests += other.requests;
+        bytes += other.bytes;
+        non2xx += other.non2xx;
+        connects += other.connects;
+        connectErrors += other.connectErrors;
+        readErrors += other.readErrors;
+        latencySum += other.latencySum;
+        latencyMax = std::max(latencyMax, other.latencyMax);
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            histogram[i] += other.histogram[i];
+        }
+    }
+
+    // 分位数（微秒），取累计计数首次达到目标的桶的上界，不超过实测最大值
+    uint64_t percentile(double p) const {
+        uint64_t target = static_cast<uint64_t>(p / 100.0 * static_cast<double>(requests) + 0.5);
+        target = std::max<uint64_t>(target, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            seen += histogram[i];
+            if (seen >= target) {
+                return std::min(Metrics::bucketUpperBound(static_cast<int>(i)), latencyMax);
+            }
+        }
+        return latencyMax;
+    }
+};
+
+class Worker;
+
+// 一个客户端连接：按计划发送请求，解析响应并记录延迟
+// 短连接模式和服务器声明Connection: close时，连接关闭后重新建立，未收到响应的请求在新连接上重发
+class Client {
+public:
+    Client(Worker* worker, int id);
+    ~Client();
+
+    // 禁止拷贝构造和赋值
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    void start(Timestamp begin);
+
+    // 把计划时间已到、且未超过流水线深度的请求放入队列并发送
+    void sendDue(Timestamp now);
+
+private:
+    void connect();
+    void connectFailed();
+    void closeSocket();
+    void reconnect(Timestamp now);
+    void writeRequests();
+    void flushOutput();
+
+    void handleRead();
+    void handleWrite();
+    void handleClose();
+
+    // 解析收到的响应；返回true表示服务器将关闭连接
+    bool parseResponses(Timestamp now);
+
+    // 第index个请求的计划发送时间
+    Timestamp intendedTime(int64_t index) const {
+        return Timestamp(startMicroSeconds_ + static_cast<int64_t>(static_cast<double>(index) * intervalMicroSeconds_));
+    }
+
+    Worker* worker_;
+    EventLoop* loop_;
+    const Options& options_;
+    const int id_;
+    const int depth_;                   // 流水线深度
+    const double intervalMicroSeconds_; // 每个连接的请求间隔，0表示闭环
+
+    int fd_;
+    bool connected_;
+    int generation_;                    // 每个套接字一个编号，旧Channel的残余事件据此忽略
+    std::unique_ptr<Channel> channel_;
+    Buffer input_;
+    std::string output_;
+    size_t outputOffset_;
+
+    std::deque<Timestamp> inflight_;    // 未收到响应的请求的计划发送时间（或排队时间）
+    size_t unsent_;                     // inflight_中尚未写入输出缓冲区的请求数
+    int64_t startMicroSeconds_;
+    int64_t scheduled_;                 // 已安排的请求数（开环模式）
+    bool timerArmed_;
+    bool retryArmed_;
+    size_t nextPath_;
+
+    // 当前响应的解析状态
+    bool headerParsed_;
+    size_t bodyRemaining_;
+    int status_;
+    bool closeAfter_;
+};
+
+// 一个压测线程：拥有自己的EventLoop和一组连接
+class Worker {
+public:
+    Worker(const Options& options, const InetAddress& server, int index,
+           int firstClient, int numClients)
+        : options_(options), server_(server), index_(index),
+          firstClient_(firstClient), numClients_(numClients),
+          loop_(nullptr), elapsed_(0.0) {}
+
+    void run();
+
+    EventLoop* loop() const { return loop_; }
+    const Options& options() const { return options_; }
+    const InetAddress& server() const { return server_; }
+    Stats& stats() { return stats_; }
+    double elapsed() const { return elapsed_; }
+
+    // 每个路径一份预先生成的请求报文
+    const std::string& request(size_t index) const { return requests_[index % requests_.size()]; }
+
+private:
+    const Options& options_;
+    const InetAddress& server_;
+    const int index_;
+    const int firstClient_;
+    const int numClients_;
+    EventLoop* loop_;
+    std::vector<std::string> requests_;
+    Stats stats_;
+    double elapsed_;
+};
+
+Client::Client(Worker* worker, int id)
+    : worker_(worker),
+      loop_(worker->loop()),
+      options_(worker->options()),
+      id_(id),
+      depth_(options_.keepAlive ? options_.pipeline : 1),
+      intervalMicroSeconds_(options_.rate > 0.0 ? options_.connections / options_.rate * 1000000.0 : 0.0),
+      fd_(-1),
+      connected_(false),
+      generation_(0),
+      outputOffset_(0),
+      unsent_(0),
+      startMicroSeconds_(0),
+      scheduled_(0),
+      timerArmed_(false),
+      retryArmed_(false),
+      nextPath_(static_cast<size_t>(id)),
+      headerParsed_(false),
+      bodyRemaining_(0),
+      status_(0),
+      closeAfter_(false) {
+}
+
+Client::~Client() {
+    closeSocket();
+}
+
+void Client::start(Timestamp begin) {
+    // 开环模式下各连接的计划时间错开，合计的请求均匀分布
+    startMicroSeconds_ = begin.microSecondsSinceEpoch() +
+        static_cast<int64_t>(intervalMicroSeconds_ * id_ / options_.connections);
+    sendDue(begin);
+}
+
+void Client::sendDue(Timestamp now) {
+    while (static_cast<int>(inflight_.size()) < depth_) {
+        Timestamp intended = now;
+        if (intervalMicroSeconds_ > 0.0) {
+            intended = intendedTime(scheduled_);
+            if (now < intended) {
+                // 下一个请求还没到时间，到时再发
+                if (!timerArmed_) {
+                    timerArmed_ = true;
+                    loop_->runAt(intended, [this]() {
+                        timerArmed_ = false;
+                        sendDue(Timestamp::now());
+                    });
+                }
+                break;
+            }
+            ++scheduled_;
+        }
+        inflight_.push_back(intended);
+        ++unsent_;
+    }
+
+    if (unsent_ > 0) {
+        if (fd_ < 0) {
+            if (!retryArmed_) {
+                connect();
+            }
+        } else if (connected_) {
+            writeRequests();
+        }
+    }
+}
+
+void Client::connect() {
+    fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (fd_ < 0) {
+        connectFailed();
+        return;
+    }
+    int on = 1;
+    ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+    const InetAddress& server = worker_->server();
+    int ret = ::connect(fd_, server.getSockAddr(), server.getSockAddrLen());
+    if (ret < 0 && errno != EINPROGRESS) {
+        ::close(fd_);
+        fd_ = -1;
+        connectFailed();
+        return;
+    }
+
+    ++generation_;
+    int generation = generation_;
+    channel_.reset(new Channel(loop_, fd_));
+    channel_->setReadCallback([this, generation]() {
+        if (generation == generation_) handleRead();
+    });
+    channel_->setWriteCallback([this, generation]() {
+        if (generation == generation_) handleWrite();
+    });
+    channel_->setCloseCallback([this, generation]() {
+        if (generation == generation_) handleClose();
+    });
+    // 连接建立（或失败）时套接字可写
+    channel_->enableWriting();
+}
+
+void Client::connectFailed() {
+    ++worker_->stats().connectErrors;
+    closeSocket();
+    unsent_ = inflight_.size();
+    // 稍后重试（如服务器未启动、短连接模式下本地端口耗尽）
+    if (!retryArmed_) {
+        retryArmed_ = true;
+        loop_->runAfter(0.01, [this]() {
+            retryArmed_ = false;
+            if (fd_ < 0) {
+                sendDue(Timestamp::now());
+            }
+        });
+    }
+}
+
+void Client::closeSocket() {
+    if (fd_ < 0) {
+        return;
+    }
+    if (channel_) {
+        channel_->disableAll();
+        loop_->removeChannel(channel_.get());
+        // 可能正处于该Channel的handleEvent中，延后析构
+        std::shared_ptr<Channel> channel(channel_.release());
+        loop_->queueInLoop([channel]() {});
+    }
+    ::close(fd_);
+    fd_ = -1;
+    connected_ = false;
+    input_.retrieveAll();
+    output_.clear();
+    outputOffset_ = 0;
+    headerParsed_ = false;
+    bodyRemaining_ = 0;
+    closeAfter_ = false;
+}
+
+void Client::reconnect(Timestamp now) {
+    closeSocket();
+    // 未收到响应的请求在新连接上重发，计划时间不变
+    unsent_ = inflight_.size();
+    sendDue(now);
+}
+
+void Client::writeRequests() {
+    for (; unsent_ > 0; --unsent_) {
+        output_ += worker_->request(nextPath_++);
+    }
+    flushOutput();
+}
+
+void Client::flushOutput() {
+    while (outputOffset_ < output_.size()) {
+        ssize_t n = ::send(fd_, output_.data() + outputOffset_, output_.size() - outputOffset_, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN) {
+                // 连接已断开，等读事件处理
+                output_.clear();
+                outputOffset_ = 0;
+            }
+            break;
+        }
+        outputOffset_ += static_cast<size_t>(n);
+    }
+    if (outputOffset_ == output_.size()) {
+        output_.clear();
+        outputOffset_ = 0;
+        if (channel_->isWriting()) {
+            channel_->disableWriting();
+        }
+    } else if (!channel_->isWriting()) {
+        channel_->enableWriting();
+    }
+}
+
+void Client::handleWrite() {
+    if (!connected_) {
+        int err = 0;
+        socklen_t len = sizeof err;
+        if (::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+            err = errno;
+        }
+        if (err != 0) {
+            connectFailed();
+            return;
+        }
+        connected_ = true;
+        ++worker_->stats().connects;
+        channel_->disableWriting();
+        channel_->enableReading();
+        unsent_ = inflight_.size();
+        writeRequests();
+        return;
+    }
+    flushOutput();
+}
+
+void Client::handleRead() {
+    int savedErrno = 0;
+    ssize_t n = input_.readFd(fd_, &savedErrno);
+    Timestamp now(Timestamp::now());
+    if (n > 0) {
+        if (parseResponses(now)) {
+            reconnect(now);
+        } else {
+            sendDue(now);
+        }
+    } else if (n == 0 || savedErrno != EAGAIN) {
+        // 服务器意外关闭连接（如读超时），有未完成的请求时计为错误
+        if (!inflight_.empty()) {
+            ++worker_->stats().readErrors;
+        }
+        reconnect(now);
+    }
+}
+
+void Client::handleClose() {
+    if (!connected_) {
+        connectFailed();
+        return;
+    }
+    if (!inflight_.empty()) {
+        ++worker_->stats().readErrors;
+    }
+    reconnect(Timestamp::now());
+}
+
+bool Client::parseResponses(Timestamp now) {
+    Stats& stats = worker_->stats();
+    while (input_.readableBytes() > 0) {
+        if (!headerParsed_) {
+            const char* begin = input_.peek();
+            const char* limit = begin + input_.readableBytes();
+            const char* end = std::search(begin, limit, kCRLFCRLF, kCRLFCRLF + 4);
+            if (end == limit) {
+                break;
+            }
+            // 状态行"HTTP/1.1 200 OK"
+            status_ = (end - begin > 12 && strncmp(begin, "HTTP/1.", 7) == 0) ? atoi(begin + 9) : 0;
+            bodyRemaining_ = 0;
+            const char* line = std::find(begin, end, '\n') + 1;
+            while (line < end) {
+                const char* lineEnd = std::find(line, end, '\r');
+                size_t len = static_cast<size_t>(lineEnd - line);
+                if (len > 15 && strncasecmp(line, "Content-Length:", 15) == 0) {
+                    bodyRemaining_ = static_cast<size_t>(strtoull(line + 15, nullptr, 10));
+                } else if (len > 11 && strncasecmp(line, "Connection:", 11) == 0) {
+                    std::string value(line + 11, lineEnd);
+                    closeAfter_ = strcasestr(value.c_str(), "close") != nullptr;
+                }
+                line = lineEnd + 2;
+            }
+            size_t headerLength = static_cast<size_t>(end + 4 - begin);
+            stats.bytes += headerLength;
+            input_.retrieve(headerLength);
+            headerParsed_ = true;
+        }
+
+        // 响应体只计数，不保留
+        size_t n = std::min(input_.readableBytes(), bodyRemaining_);
+        input_.retrieve(n);
+        bodyRemaining_ -= n;
+        stats.bytes += n;
+        if (bodyRemaining_ > 0) {
+            break;
+        }
+
+        // 一个响应接收完毕
+        headerParsed_ = false;
+        if (!inflight_.empty()) {
+            stats.record(now.microSecondsSinceEpoch() - inflight_.front().microSecondsSinceEpoch());
+            inflight_.pop_front();
+        }
+        if (status_ < 200 || status_ >= 300) {
+            ++stats.non2xx;
+        }
+        if (closeAfter_) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Worker::run() {
+    char name[32];
+    snprintf(name, sizeof name, "bench%d", index_);
+    setCurrentThreadName(name);
+
+    for (const std::string& path : options_.paths) {
+        std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + options_.host + "\r\n";
+        if (!options_.keepAlive) {
+            request += "Connection: close\r\n";
+        }
+        request += "\r\n";
+        requests_.push_back(request);
+    }
+
+    EventLoop loop;
+    loop_ = &loop;
+    std::vector<std::unique_ptr<Client> > clients;
+    for (int i = 0; i < numClients_; ++i) {
+        clients.emplace_back(new Client(this, firstClient_ + i));
+    }
+
+    Timestamp begin(Timestamp::now());
+    for (const std::unique_ptr<Client>& client : clients) {
+        client->start(begin);
+    }
+    loop.runAfter(options_.duration, [&loop]() { loop.quit(); });
+    loop.loop();
+    elapsed_ = timeDifference(Timestamp::now(), begin);
+
+    clients.clear();
+    loop_ = nullptr;
+}
+
+void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-c connections] [-t threads] [-d seconds] [-p pipeline]\n"
+            "          [-r requests/sec] [-C] [-u path]... [host] [port]\n", prog);
+}
+
+void printLatency(const char* label, uint64_t microSeconds) {
+    printf("  %-8s %10.3f ms\n", label, static_cast<double>(microSeconds) / 1000.0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:d:p:r:Cu:h")) != -1) {
+        switch (opt) {
+        case 'c': options.connections = atoi(optarg); break;
+        case 't': options.threads = atoi(optarg); break;
+        case 'd': options.duration = atof(optarg); break;
+        case 'p': options.pipeline = atoi(optarg); break;
+        case 'r': options.rate = atof(optarg); break;
+        case 'C': options.keepAlive = false; break;
+        case 'u': options.paths.push_back(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        options.host = argv[optind++];
+    }
+    if (optind < argc) {
+        options.port = static_cast<uint16_t>(atoi(argv[optind++]));
+    }
+    if (options.paths.empty()) {
+        options.paths.push_back("/");
+    }
+    if (options.connections <= 0 || options.threads <= 0 || options.duration <= 0.0 ||
+        options.pipeline <= 0 || options.rate < 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+    InetAddress server(options.host, options.port);
+
+    printf("Running %.1fs test @ http://%s:%u\n", options.duration, options.host.c_str(), options.port);
+    printf("  %d threads, %d connections, %s, pipeline %d, ",
+           options.threads, options.connections,
+           options.keepAlive ? "keep-alive" : "connection: close",
+           options.keepAlive ? options.pipeline : 1);
+    if (options.rate > 0.0) {
+        printf("target %.0f req/s\n", options.rate);
+    } else {
+        printf("unthrottled\n");
+    }
+    printf("  paths:");
+    for (const std::string& path : options.paths) {
+        printf(" %s", path.c_str());
+    }
+    printf("\n");
+
+    // 连接平均分配到各线程
+    std::vector<std::unique_ptr<Worker> > workers;
+    int first = 0;
+    for (int i = 0; i < options.threads; ++i) {
+        int count = options.connections / options.threads + (i < options.connections % options.threads ? 1 : 0);
+        workers.emplace_back(new Worker(options, server, i, first, count));
+        first += count;
+    }
+    std::vector<std::thread> threads;
+    for (const std::unique_ptr<Worker>& worker : workers) {
+        threads.emplace_back(&Worker::run, worker.get());
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    Stats total;
+    double elapsed = 0.0;
+    for (const std::unique_ptr<Worker>& worker : workers) {
+        total.merge(worker->stats());
+        elapsed = std::max(elapsed, worker->elapsed());
+    }
+
+    printf("Requests:   %llu in %.2fs, %.1f req/s\n",
+           static_cast<unsigned long long>(total.requests), elapsed,
+           static_cast<double>(total.requests) / elapsed);
+    printf("Transfer:   %.2f MB, %.2f MB/s\n",
+           static_cast<double>(total.bytes) / (1024.0 * 1024.0),
+           static_cast<double>(total.bytes) / (1024.0 * 1024.0) / elapsed);
+    printf("Connects:   %llu\n", static_cast<unsigned long long>(total.connects));
+    printf("Errors:     connect %llu, read %llu, non-2xx %llu\n",
+           static_cast<unsigned long long>(total.connectErrors),
+           static_cast<unsigned long long>(total.readErrors),
+           static_cast<unsigned long long>(total.non2xx));
+    printf("Latency (%s):\n",
+           options.rate > 0.0 ? "from intended send time, corrected for coordinated omission"
+                              : "from actual send time");
+    if (total.requests > 0) {
+        printLatency("mean", total.latencySum / total.requests);
+        printLatency("p50", total.percentile(50.0));
+        printLatency("p75", total.percentile(75.0));
+        printLatency("p90", total.percentile(90.0));
+        printLatency("p99", total.percentile(99.0));
+        printLatency("p99.9", total.percentile(99.9));
+        printLatency("p99.99", total.percentile(99.99));
+        printLatency("max", total.latencyMax);
+    }
+    return 0;
+}
@@ -0,0 +1,444 @@
+// 微基准测试：单独测量热点辅助函数的耗时和内存分配次数
+//
+// 用法: micro_bench [--filter 子串] [--min-time 秒] [--json 文件]
+//   --filter    只运行名称包含该子串的用例
+//   --min-time  每次采样的最短时间（默认0.1秒），共采样5次取中位数
+//   --json      结果另存为JSON（"-"表示标准输出），便于在不同提交之间比较
+//
+// 通过替换全局operator new统计每次操作的分配次数和字节数（包括核心库内部的分配）。
+#include "buffer.h"
+#include "http_connection.h"
+#include "http_request.h"
+#include "static_file_cache.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<uint64_t> g_allocations(0);
+std::atomic<uint64_t> g_allocatedBytes(0);
+
+} // namespace
+
+// 替换全局的分配函数，只计数，不改变分配行为
+// （operator delete内调用free是配对的，GCC无法识别替换后的operator new，关闭该误报）
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+namespace {
+
+// 阻止编译器把被测结果当作无用代码删除
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// 请求样本：浏览器、curl和表单提交
+const char kBrowserRequest[] =
+    "GET /style.css HTTP/1.1\r\n"
+    "Host: localhost:8888\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/124.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: style\r\n"
+    "Referer: http://localhost:8888/\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n"
+    "\r\n";
+
+const char kCurlRequest[] =
+    "GET /api/test HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8888\r\n"
+    "User-Agent: curl/8.5.0\r\n"
+    "Accept: */*\r\n"
+    "\r\n";
+
+const char kPostBody[] = "name=%E5%BC%A0%E4%B8%89&email=zhang%40example.com&age=30&x=1";
+
+// 表单提交的Content-Length由请求体计算
+const std::string& postRequest() {
+    static const std::string request =
+        std::string("POST /api/submit HTTP/1.1\r\n"
+                    "Host: localhost:8888\r\n"
+                    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:125.0) Gecko/20100101 Firefox/125.0\r\n"
+                    "Accept: application/json\r\n"
+                    "Content-Type: application/x-www-form-urlencoded\r\n"
+                    "Content-Length: ") + std::to_string(strlen(kPostBody)) + "\r\n"
+        "Origin: http://localhost:8888\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n" + kPostBody;
+    return request;
+}
+
+const char* const kPaths[] = {
+    "/", "/index.html", "/css/../style.css", "/static/img/logo.png",
+    "/a/b/c/d/e/../../f/g.js", "/../../etc/passwd", "/docs//guide/./intro.html",
+};
+
+const char* const kFilenames[] = {
+    "index.html", "style.css", "app.min.js", "logo.PNG", "photo.jpeg",
+    "data.json", "archive.tar.gz", "README", "video.mp4", "font.woff2",
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+};
+
+// 被测函数执行iterations次操作
+typedef std::function<void(uint64_t iterations)> BenchFunc;
+
+struct Benchmark {
+    const char* name;
+    BenchFunc func;
+};
+
+double runOnce(const BenchFunc& func, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    func(iterations);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// 先倍增迭代次数直到单次采样达到minTime，再采样5次取中位数
+Result measure(const Benchmark& bench, double minTime) {
+    uint64_t iterations = 1;
+    while (true) {
+        double seconds = runOnce(bench.func, iterations);
+        if (seconds >= minTime || iterations >= (1ull << 40)) {
+            break;
+        }
+        double scale = seconds > 0.0 ? minTime / seconds * 1.2 : 100.0;
+        iterations = static_cast<uint64_t>(static_cast<double>(iterations) * std::min(std::max(scale, 2.0), 100.0));
+    }
+
+    const int kSamples = 5;
+    std::vector<double> samples;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    for (int i = 0; i < kSamples; ++i) {
+        uint64_t allocBefore = g_allocations.load(std::memory_order_relaxed);
+        uint64_t bytesBefore = g_allocatedBytes.load(std::memory_order_relaxed);
+        samples.push_back(runOnce(bench.func, iterations));
+        allocations += g_allocations.load(std::memory_order_relaxed) - allocBefore;
+        bytes += g_allocatedBytes.load(std::memory_order_relaxed) - bytesBefore;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = bench.name;
+    result.iterations = iterations;
+    result.nsPerOp = samples[kSamples / 2] * 1e9 / static_cast<double>(iterations);
+    double ops = static_cast<double>(iterations) * kSamples;
+    result.allocsPerOp = static_cast<double>(allocations) / ops;
+    result.bytesPerOp = static_cast<double>(bytes) / ops;
+    return result;
+}
+
+// 每次迭代把请求追加到Buffer再解析，Buffer在迭代之间复用
+void parseLoop(const std::string& request, uint64_t iterations) {
+    const char* data = request.data();
+    const size_t len = request.size();
+    Buffer buffer;
+    HttpRequest parser;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        buffer.append(data, len);
+        HttpRequest::ParseResult result = parser.parse(&buffer);
+        doNotOptimize(result);
+        buffer.retrieveAll();
+        parser.reset();
+    }
+}
+
+// 解析请求并生成响应（不发送）
+void processLoop(const std::string& request, uint64_t iterations) {
+    const char* data = request.data();
+    const size_t len = request.size();
+    Buffer buffer;
+    HttpConnection connection;
+    connection.setMaxRequests(0);
+    std::string header, body, trailer;
+    for (uint64_t i = 0; i < iterations; ++i) {
+        buffer.append(data, len);
+        HttpRequest::ParseResult result = connection.process(&buffer);
+        doNotOptimize(result);
+        connection.takeResponse(&header, &body, &trailer);
+        doNotOptimize(connection.takeResponseContent());
+        doNotOptimize(connection.takeResponseFile());
+        connection.reset();
+    }
+}
+
+// 请求样本必须各自恰好是一个完整的请求，否则解析用例测的是不完整的请求、
+// 处理用例的请求边界会错位；启动时检查一次，样本有误时直接失败
+bool checkCorpus() {
+    const std::string corpus[] = {
+        std::string(kBrowserRequest), std::string(kCurlRequest), postRequest()
+    };
+    bool ok = true;
+    for (const std::string& request : corpus) {
+        const std::string firstLine = request.substr(0, request.find("\r\n"));
+        Buffer buffer;
+        buffer.append(request.data(), request.size());
+        HttpRequest parser;
+        if (parser.parse(&buffer) != HttpRequest::ParseResult::COMPLETE ||
+            parser.requestLength() != request.size()) {
+            fprintf(stderr, "corpus error: \"%s\" does not parse as one complete request\n",
+                    firstLine.c_str());
+            ok = false;
+            continue;
+        }
+        HttpConnection connection;
+        connection.setMaxRequests(0);
+        if (connection.process(&buffer) != HttpRequest::ParseResult::COMPLETE ||
+            buffer.readableBytes() != 0) {
+            fprintf(stderr, "corpus error: \"%s\" is not consumed exactly by HttpConnection::process\n",
+                    firstLine.c_str());
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+std::vector<Benchmark> makeBenchmarks() {
+    std::vector<Benchmark> benchmarks;
+
+    benchmarks.push_back({"buffer/append_64B", [](uint64_t iterations) {
+        char chunk[64];
+        memset(chunk, 'x', sizeof chunk);
+        Buffer buffer;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            buffer.append(chunk, sizeof chunk);
+            if (buffer.readableBytes() >= 16 * 1024) {
+                buffer.retrieveAll();
+            }
+        }
+        doNotOptimize(buffer.readableBytes());
+    }});
+
+    // 每次追加多于消费，可写空间不足时触发makeSpace（搬移数据或扩容）
+    benchmarks.push_back({"buffer/append_retrieve_makeSpace", [](uint64_t iterations) {
+        char chunk[1500];
+        memset(chunk, 'x', sizeof chunk);
+        Buffer buffer;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            buffer.append(chunk, sizeof chunk);
+            buffer.retrieve(buffer.readableBytes() > 4096 ? buffer.readableBytes() - 512 : 1000);
+        }
+        doNotOptimize(buffer.readableBytes());
+    }});
+
+    benchmarks.push_back({"buffer/findCRLF_browser", [](uint64_t iterations) {
+        Buffer buffer;
+        buffer.append(kBrowserRequest, strlen(kBrowserRequest));
+        for (uint64_t i = 0; i < iterations; ++i) {
+            // 逐行查找，与解析请求头的访问模式一致
+            const char* start = buffer.peek();
+            const char* crlf;
+            while ((crlf = buffer.findCRLF(start)) != nullptr) {
+                start = crlf + 2;
+            }
+            doNotOptimize(start);
+        }
+    }});
+
+    benchmarks.push_back({"http_request/parse_browser", [](uint64_t iterations) {
+        static const std::string request(kBrowserRequest);
+        parseLoop(request, iterations);
+    }});
+    benchmarks.push_back({"http_request/parse_curl", [](uint64_t iterations) {
+        static const std::string request(kCurlRequest);
+        parseLoop(request, iterations);
+    }});
+    benchmarks.push_back({"http_request/parse_post", [](uint64_t iterations) {
+        parseLoop(postRequest(), iterations);
+    }});
+
+    benchmarks.push_back({"http_connection/process_browser_static", [](uint64_t iterations) {
+        static const std::string request(kBrowserRequest);
+        processLoop(request, iterations);
+    }});
+    benchmarks.push_back({"http_connection/process_curl_api", [](uint64_t iterations) {
+        static const std::string request(kCurlRequest);
+        processLoop(request, iterations);
+    }});
+    benchmarks.push_back({"http_connection/process_post_form", [](uint64_t iterations) {
+        processLoop(postRequest(), iterations);
+    }});
+
+    benchmarks.push_back({"utils/normalizePath", [](uint64_t iterations) {
+        const size_t count = sizeof kPaths / sizeof kPaths[0];
+        std::vector<std::string> paths(kPaths, kPaths + count);
+        for (uint64_t i = 0; i < iterations; ++i) {
+            doNotOptimize(normalizePath(paths[i % count]));
+        }
+    }});
+    benchmarks.push_back({"utils/safePathJoin", [](uint64_t iterations) {
+        const size_t count = sizeof kPaths / sizeof kPaths[0];
+        std::vector<std::string> paths(kPaths, kPaths + count);
+        std::string root("/home/WebFileServer/public");
+        std::string result;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            doNotOptimize(safePathJoin(root, paths[i % count], result));
+        }
+    }});
+    benchmarks.push_back({"utils/split", [](uint64_t iterations) {
+        std::string path("/a/b/c/d/e/../../f/g.js");
+        for (uint64_t i = 0; i < iterations; ++i) {
+            doNotOptimize(split(path, '/'));
+        }
+    }});
+
+    benchmarks.push_back({"mime/utils_getMimeType", [](uint64_t iterations) {
+        const size_t count = sizeof kFilenames / sizeof kFilenames[0];
+        std::vector<std::string> names(kFilenames, kFilenames + count);
+        for (uint64_t i = 0; i < iterations; ++i) {
+            doNotOptimize(getMimeType(names[i % count]));
+        }
+    }});
+    benchmarks.push_back({"mime/StaticFileCache_mimeType", [](uint64_t iterations) {
+        const size_t count = sizeof kFilenames / sizeof kFilenames[0];
+        std::vector<std::string> names(kFilenames, kFilenames + count);
+        for (uint64_t i = 0; i < iterations; ++i) {
+            doNotOptimize(StaticFileCache::mimeType(names[i % count]));
+        }
+    }});
+
+    return benchmarks;
+}
+
+// JSON字符串转义（用例名称只含可打印字符）
+std::string jsonString(const std::string& s) {
+    std::string out("\"");
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    out += '"';
+    return out;
+}
+
+bool writeJson(const std::string& path, const std::vector<Result>& results, double minTime) {
+    FILE* fp = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if (!fp) {
+        perror(path.c_str());
+        return false;
+    }
+    fprintf(fp, "{\n  \"min_time\": %g,\n  \"benchmarks\": [\n", minTime);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        fprintf(fp, "    {\"name\": %s, \"iterations\": %llu, \"ns_per_op\": %.3f, "
+                    "\"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f}%s\n",
+                jsonString(r.name).c_str(), static_cast<unsigned long long>(r.iterations),
+                r.nsPerOp, r.allocsPerOp, r.bytesPerOp, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return true;
+}
+
+void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--filter substring] [--min-time seconds] [--json file|-]\n", prog);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string jsonPath;
+    double minTime = 0.1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            minTime = atof(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+    if (minTime <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!checkCorpus()) {
+        return 1;
+    }
+
+    // JSON输出到标准输出时，表格输出到标准错误
+    FILE* table = jsonPath == "-" ? stderr : stdout;
+    fprintf(table, "%-40s %14s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+
+    std::vector<Result> results;
+    for (const Benchmark& bench : makeBenchmarks()) {
+        if (!filter.empty() && strstr(bench.name, filter.c_str()) == nullptr) {
+            continue;
+        }
+        Result r = measure(bench, minTime);
+        fprintf(table, "%-40s %14llu %12.1f %12.2f %12.1f\n", r.name.c_str(),
+                static_cast<unsigned long long>(r.iterations), r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+        fflush(table);
+        results.push_back(r);
+    }
+
+    if (!jsonPath.empty() && !writeJson(jsonPath, results, minTime)) {
+        return 1;
+    }
+    return 0;
+}
@@ -6,28 +6,60 @@
 #include "inet_address.h"
 #include <functional>
 #include <memory>
+#include <vector>
 
 class EventLoop;
+class Poller;
 
 class Acceptor {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
 
+    // 一次唤醒中接受的连接
+    struct AcceptedConnection {
+        int sockfd;
+        InetAddress peerAddr;
+    };
+    using AcceptedConnectionList = std::vector<AcceptedConnection>;
+    using NewConnectionsCallback = std::function<void(const AcceptedConnectionList&)>;
+
+    // 每次唤醒默认最多接受的连接数
+    static const int kDefaultAcceptBatch = 32;
+
     Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
+
+    // 共享监听套接字：在loop上监听listenFd指向的同一个套接字（内部dup一份描述符）
+    // exclusive为true时使用EPOLLEXCLUSIVE，一个连接到达只唤醒其中一个EventLoop
+    Acceptor(EventLoop* loop, int listenFd, bool exclusive);
+
     ~Acceptor();
 
     // 禁止拷贝构造和赋值
     Acceptor(const Acceptor&) = delete;
     Acceptor& operator=(const Acceptor&) = delete;
 
-    // 设置新连接回调函数
+    // 设置新连接回调函数（逐个回调）
     void setNewConnectionCallback(const NewConnectionCallback& cb) {
         newConnectionCallback_ = cb;
     }
 
+    // 设置批量新连接回调函数，设置后一次唤醒接受的连接一起回调，优先于逐个回调
+    void setNewConnectionsCallback(const NewConnectionsCallback& cb) {
+        newConnectionsCallback_ = cb;
+    }
+
+    // 设置每次唤醒最多接受的连接数，监听队列取空时提前结束；完成模式下连接由内核逐个接受，不受此限制
+    void setAcceptBatch(int batch) { acceptBatch_ = batch > 0 ? batch : 1; }
+
+    // 监听套接字描述符
+    int listenFd() const { return acceptSocket_.fd(); }
+
     // 判断是否正在监听
     bool listening() const { return listening_; }
 
+    // 获取所属EventLoop
+    EventLoop* getLoop() const { return loop_; }
+
     // 开始监听
     void listen();
 
@@ -35,12 +67,24 @@ private:
     // 处理连接事件
     void handleRead();
 
+    // 取走完成模式下内核已接受的连接
+    void takeCompletedAccepts();
+
+    // 文件描述符耗尽时用idleFd_接受并关闭一个连接，避免监听套接字一直可读
+    void handleFdExhaustion();
+
     // 成员变量
     EventLoop* loop_; // 所属EventLoop
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
+    NewConnectionsCallback newConnectionsCallback_;
     bool listening_;
+    bool exclusive_;                  // 是否使用EPOLLEXCLUSIVE
+    int acceptBatch_;
+    Poller* completionPoller_;        // 非空时由Poller持续接受连接（io_uring的多次触发accept）
+    std::vector<int> acceptedFds_;    // 完成模式下取走的连接，复用容量
+    AcceptedConnectionList accepted_; // 本次唤醒接受的连接，复用容量
     int idleFd_; // 用于处理文件描述符耗尽的情况
 };
 
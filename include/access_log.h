@@ -0,0 +1,121 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "string_piece.h"
+#include "timestamp.h"
+
+class InetAddress;
+
+// 访问日志：每个请求一行JSON，字段为时间、对端地址、方法、路径、状态码、响应字节数和耗时
+// 每个写日志的线程（即每个IO线程）有一个单生产者单消费者的环形缓冲区，
+// 记录在IO线程中格式化后拷贝进环形缓冲区，不执行系统调用；
+// 后台线程定期（或某个缓冲区过半时）把所有缓冲区的内容用一次writev批量写入文件。
+// 支持按大小和按时间轮转，收到SIGHUP后（requestReopen()）写完已缓冲的记录再重新打开文件。
+class AccessLog {
+public:
+    static const size_t kDefaultRingSize = 1024 * 1024;  // 每个线程的环形缓冲区大小
+
+    struct Record {
+        Timestamp time;             // 响应生成的时间
+        const InetAddress* peer;
+        StringPiece method;
+        StringPiece path;
+        int status;
+        size_t bytes;               // 响应字节数（响应头和响应体）
+        int64_t durationMicroSeconds; // 从收到请求的第一个字节到生成响应的耗时
+    };
+
+    // 全局唯一的访问日志
+    static AccessLog& instance();
+
+    // 禁止拷贝构造和赋值
+    AccessLog(const AccessLog&) = delete;
+    AccessLog& operator=(const AccessLog&) = delete;
+
+    // 以下设置需在start()之前调用
+    // 文件达到rotateBytes字节时轮转，<=0表示不按大小轮转
+    void setRotateBytes(int64_t rotateBytes) { rotateBytes_ = rotateBytes; }
+    // 每rotateSeconds秒轮转一次（按整点对齐，如86400为每天零点UTC），<=0表示不按时间轮转
+    void setRotateInterval(int rotateSeconds) { rotateSeconds_ = rotateSeconds; }
+    // 后台线程的最长刷新间隔（秒）
+    void setFlushInterval(double seconds) { flushInterval_ = seconds; }
+
+    // 打开日志文件并启动后台线程
+    bool start(const std::string& path);
+
+    // 写出所有缓冲的记录并停止后台线程
+    void stop();
+
+    // 是否在记录访问日志，IO线程据此决定是否格式化记录
+    bool enabled() const { return running_.load(std::memory_order_relaxed); }
+
+    // 追加一条记录，可在任意线程调用；缓冲区满时丢弃并计数
+    void append(const Record& record);
+
+    // 请求重新打开日志文件（如logrotate移走文件后发送SIGHUP），可在信号处理函数中调用
+    void requestReopen() { reopenRequested_.store(true, std::memory_order_relaxed); }
+
+private:
+    // 单生产者单消费者环形缓冲区，head只由生产者推进，tail只由后台线程推进
+    struct Ring {
+        explicit Ring(size_t size);
+
+        // head和tail之间填充一个缓存行，生产者和消费者互不干扰
+        // （C++11的new不保证alignas超过16字节的对齐，这里不用alignas）
+        std::unique_ptr<char[]> data;
+        const size_t capacity;                 // 2的幂
+        std::atomic<size_t> head;              // 已写入的总字节数
+        char padding[64];
+        std::atomic<size_t> tail;              // 已写出的总字节数
+        std::atomic<size_t> dropped;           // 缓冲区满时丢弃的记录数
+    };
+    typedef std::shared_ptr<Ring> RingPtr;
+
+    AccessLog();
+    ~AccessLog();
+
+    // 当前线程的环形缓冲区，首次使用时登记到后台
+    Ring* threadRing();
+
+    void threadFunc();
+
+    // 把所有环形缓冲区的内容批量写入文件
+    void flushRings();
+    bool writeFully(struct iovec* iov, int iovcnt);
+
+    // 打开、轮转、重新打开日志文件
+    bool openFile();
+    void rotate(Timestamp now);
+    void reopen();
+    void computeNextRotation(Timestamp now);
+
+    static thread_local RingPtr t_ring_;
+
+    std::string path_;
+    int fd_;
+    int64_t rotateBytes_;
+    int rotateSeconds_;
+    double flushInterval_;
+    int64_t fileBytes_;              // 当前文件已写入的字节数
+    Timestamp nextRotation_;         // 下一次按时间轮转的时间
+
+    std::atomic<bool> running_;
+    std::atomic<bool> reopenRequested_;
+    std::atomic<bool> flushPending_; // 某个缓冲区已过半，提前唤醒后台线程
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<RingPtr> rings_;
+};
+
+#endif // ACCESS_LOG_H
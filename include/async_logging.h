@@ -0,0 +1,101 @@
+#ifndef ASYNC_LOGGING_H
+#define ASYNC_LOGGING_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 异步日志后端：每个写日志的线程有自己的前端缓冲区，后台线程定期或在缓冲区写满时
+// 把各线程的缓冲区整块换出并写入文件，前端只做一次内存拷贝，不执行系统调用。
+// 每个线程的缓冲区有自己的锁，只有该线程和后台线程会竞争，线程之间互不影响。
+// 同一线程的日志保持顺序，不同线程的日志按块交错写出，以每行的时间戳为准。
+class AsyncLogging {
+public:
+    static const size_t kBufferSize = 64 * 1024;   // 单个缓冲区大小
+    static const size_t kMaxPendingBuffers = 16;   // 每个线程积压的写满缓冲区上限，超过时丢弃日志
+
+    // 全局唯一的异步日志后端
+    static AsyncLogging& instance();
+
+    // 禁止拷贝构造和赋值
+    AsyncLogging(const AsyncLogging&) = delete;
+    AsyncLogging& operator=(const AsyncLogging&) = delete;
+
+    // 启动后台线程并接管Logger的输出；path为空时写到标准错误
+    // flushInterval为最长的刷新间隔（秒）
+    bool start(const std::string& path = std::string(), double flushInterval = 1.0);
+
+    // 写出所有缓冲的日志，停止后台线程，Logger恢复为同步输出
+    void stop();
+
+    bool started() const { return running_; }
+
+    // 追加一条日志，可在任意线程调用
+    void append(const char* msg, size_t len);
+
+    // 立即写出所有缓冲的日志（LOG_FATAL时调用）
+    void flush();
+
+private:
+    // 定长缓冲区
+    struct LogBuffer {
+        char data[kBufferSize];
+        size_t length;
+
+        LogBuffer() : length(0) {}
+        size_t avail() const { return kBufferSize - length; }
+    };
+    typedef std::unique_ptr<LogBuffer> BufferPtr;
+
+    // 每个线程的前端缓冲区
+    struct ThreadBuffer {
+        std::mutex mutex;
+        BufferPtr current;               // 正在写入的缓冲区
+        std::vector<BufferPtr> full;     // 已写满、等待后台线程写出的缓冲区
+        std::vector<BufferPtr> spare;    // 后台线程归还的空缓冲区
+        size_t dropped;                  // 积压过多时丢弃的日志条数
+
+        ThreadBuffer() : current(new LogBuffer()), dropped(0) {}
+    };
+    typedef std::shared_ptr<ThreadBuffer> ThreadBufferPtr;
+
+    AsyncLogging();
+    ~AsyncLogging();
+
+    // 当前线程的前端缓冲区，首次使用时登记到后台
+    ThreadBufferPtr& threadBuffer();
+
+    void threadFunc();
+
+    // 换出所有线程的缓冲区并写出；调用方持有writeMutex_
+    void writeAll();
+    void writeThread(const ThreadBufferPtr& thread);
+    void writeToFile(const char* data, size_t len);
+
+    static void output(const char* msg, size_t len);
+    static void flushOutput();
+
+    // 每个线程持有自己的前端缓冲区；后台线程也持有一份引用，线程退出后内容不会丢失
+    static thread_local ThreadBufferPtr t_threadBuffer_;
+
+    std::atomic<bool> running_;
+    int fd_;
+    bool ownFd_;
+    double flushInterval_;
+    std::thread thread_;
+
+    // 登记的线程缓冲区，线程退出后留到内容写完再移除
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<ThreadBufferPtr> threadBuffers_;
+    bool fullPending_;
+
+    // 保证写出的顺序，后台线程和flush()互斥
+    std::mutex writeMutex_;
+};
+
+#endif // ASYNC_LOGGING_H
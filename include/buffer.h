@@ -128,6 +128,11 @@ public:
         buffer_.swap(buf);
     }
 
+    // 底层存储的容量
+    size_t internalCapacity() const {
+        return buffer_.capacity();
+    }
+
     // 从文件描述符读取数据
     ssize_t readFd(int fd, int* savedErrno);
 
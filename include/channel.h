@@ -42,8 +42,14 @@ public:
     // 获取文件描述符
     int fd() const { return fd_; }
 
-    // 获取关注的事件
-    uint32_t events() const { return events_; }
+    // 获取关注的事件（边沿触发时带EPOLLET）
+    uint32_t events() const {
+        return edgeTriggered_ && events_ != kNoneEvent ? events_ | EPOLLET : events_;
+    }
+
+    // 边沿触发：事件只在状态变化时通知一次，使用者必须读写到EAGAIN；需在启用事件之前设置
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    bool edgeTriggered() const { return edgeTriggered_; }
 
     // 设置发生的事件
     void set_revents(uint32_t revt) { revents_ = revt; }
@@ -75,6 +81,22 @@ public:
         update();
     }
 
+    // 同时启用读写事件，只更新一次Poller（边沿触发的连接一直关注可写事件）
+    void enableReadingAndWriting() {
+        events_ |= kReadEvent | kWriteEvent;
+        update();
+    }
+
+    // 启用读事件，多个epoll实例监听同一个描述符时只唤醒其中一个（EPOLLEXCLUSIVE）
+    // 只能在首次加入epoll时使用：内核不允许EPOLL_CTL_MOD，也不允许与EPOLLPRI同时设置
+    void enableExclusiveReading() {
+        events_ = EPOLLIN;
+#ifdef EPOLLEXCLUSIVE
+        events_ |= EPOLLEXCLUSIVE;
+#endif
+        update();
+    }
+
     // 禁用所有事件
     void disableAll() {
         events_ = kNoneEvent;
@@ -87,8 +109,14 @@ public:
     // 判断是否关注写事件
     bool isWriting() const { return events_ & kWriteEvent; }
 
+    // 关注的事件已修改、尚未应用到Poller（由EventLoop在下一次poll之前统一应用）
+    bool dirty() const { return dirtyIndex_ >= 0; }
+    // 在EventLoop待更新列表中的下标，-1表示不在列表中
+    int dirtyIndex() const { return dirtyIndex_; }
+    void setDirtyIndex(int idx) { dirtyIndex_ = idx; }
+
     // 获取Channel索引（用于Poller）
-    int index() { return index_; }
+    int index() const { return index_; }
 
     // 设置Channel索引
     void set_index(int idx) { index_ = idx; }
@@ -97,7 +125,7 @@ public:
     EventLoop* ownerLoop() { return loop_; }
 
 private:
-    // 更新Channel在Poller中的状态
+    // 关注的事件已修改，登记到EventLoop等待统一更新
     void update();
 
     // 处理事件的辅助函数
@@ -111,6 +139,8 @@ private:
     uint32_t events_;  // 关注的事件
     uint32_t revents_; // 发生的事件
     int index_;        // 在Poller中的索引
+    bool edgeTriggered_; // 是否边沿触发
+    int dirtyIndex_;     // 在EventLoop待更新列表中的下标，-1表示未登记
     
     // 回调函数
     ReadEventCallback readCallback_;
@@ -1,35 +1,32 @@
 #ifndef EPOLLER_H
 #define EPOLLER_H
 
+#include "poller.h"
 #include <vector>
-#include <unordered_map>
 #include <sys/epoll.h>
 #include <memory>
 
 class Channel;
 
-class Epoller {
+// 基于epoll的Poller
+class Epoller : public Poller {
 public:
-    using ChannelList = std::vector<Channel*>;
-
     Epoller();
-    ~Epoller();
-
-    // 禁止拷贝构造和赋值
-    Epoller(const Epoller&) = delete;
-    Epoller& operator=(const Epoller&) = delete;
+    ~Epoller() override;
 
     // 等待事件发生
-    int poll(int timeoutMs, ChannelList* activeChannels);
+    int poll(int timeoutMs, ChannelList* activeChannels) override;
 
-    // 更新Channel
-    void updateChannel(Channel* channel);
+    // 按Channel当前关注的事件更新epoll中的注册；与已注册的事件相同时不调用epoll_ctl
+    void updateChannel(Channel* channel) override;
 
     // 移除Channel
-    void removeChannel(Channel* channel);
+    void removeChannel(Channel* channel) override;
 
     // 检查Channel是否在Epoller中
-    bool hasChannel(Channel* channel);
+    bool hasChannel(Channel* channel) override;
+
+    const char* name() const override { return "epoll"; }
 
 private:
     // 用于填充活跃的Channel
@@ -38,11 +35,29 @@ private:
     // 更新Channel的辅助函数
     void update(int operation, Channel* channel);
 
+    // fd对应的表项，超出表的范围时返回nullptr
+    Channel* findChannel(int fd) const {
+        return fd >= 0 && static_cast<size_t>(fd) < channels_.size() ? channels_[fd].channel : nullptr;
+    }
+
+#ifdef DEBUG
+    // 调试版本中检查整张表与各Channel的状态是否一致，每次增删后调用
+    void checkConsistency() const;
+#endif
+
     // 成员变量
     static const int kInitEventListSize = 16;
+    static const size_t kInitChannelTableSize = 64;
     int epollfd_;
     std::vector<struct epoll_event> events_;
-    std::unordered_map<int, Channel*> channels_; // fd到Channel的映射
+    // fd到Channel的映射，按fd下标索引，空位的channel为nullptr；按需倍增，不随单个Channel的增删分配内存
+    // events为已注册到epoll的事件，没有注册时为0
+    struct Entry {
+        Channel* channel;
+        uint32_t events;
+    };
+    std::vector<Entry> channels_;
+    size_t numChannels_;                         // 表中的Channel数
 };
 
 #endif // EPOLLER_H
\ No newline at end of file
@@ -2,20 +2,24 @@
 #define EVENT_LOOP_H
 
 #include <functional>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <memory>
 #include <atomic>
 #include <mutex>
 #include <thread>
 #include "timestamp.h"
+#include "timer.h"
+#include "mpsc_queue.h"
 
 class Channel;
-class Epoller;
+class Poller;
+class TimerQueue;
 
 class EventLoop {
 public:
     using Functor = std::function<void()>;
-    using TaskQueue = std::vector<Functor>;
 
     EventLoop();
     ~EventLoop();
@@ -36,16 +40,27 @@ public:
     // 检查当前线程是否是创建该EventLoop的线程
     bool isInLoopThread() const;
 
-    // 在IO线程中执行回调
-    void runInLoop(Functor cb);
+    // 在IO线程中执行回调，cb为任意可调用对象（如lambda、std::bind的结果）
+    template <typename F>
+    void runInLoop(F&& cb) {
+        if (isInLoopThread()) {
+            cb();
+        } else {
+            queueInLoop(std::forward<F>(cb));
+        }
+    }
 
     // 将回调放入队列，在IO线程中执行
-    void queueInLoop(Functor cb);
+    // 回调直接保存在带有队列链接的任务对象中，入队只分配这一个对象（本线程缓存的内存优先）
+    template <typename F>
+    void queueInLoop(F&& cb) {
+        queueTask(new FunctorTask<typename std::decay<F>::type>(std::forward<F>(cb)));
+    }
 
-    // 唤醒IO线程
+    // 唤醒IO线程（无条件写eventfd）
     void wakeup();
 
-    // 更新Channel
+    // 登记关注事件已修改的Channel，在下一次poll之前统一更新到Poller
     void updateChannel(Channel* channel);
 
     // 移除Channel
@@ -54,33 +69,98 @@ public:
     // 检查Channel是否在当前EventLoop中
     bool hasChannel(Channel* channel);
 
-    // 添加定时任务
-    void runAfter(double delay, Functor cb);
-    void runEvery(double interval, Functor cb);
+    // Poller支持完成模式（见Poller）时返回它，否则返回nullptr；只能在所属IO线程使用
+    Poller* completionPoller() const;
+
+    // 定时任务，回调在IO线程中执行，可在任意线程调用
+    // 在指定时间执行
+    TimerId runAt(Timestamp time, Functor cb);
+    // 延迟delay秒后执行
+    TimerId runAfter(double delay, Functor cb);
+    // 每隔interval秒执行一次
+    TimerId runEvery(double interval, Functor cb);
+    // 取消定时任务
+    void cancel(TimerId timerId);
+
+    // 负载计数器，供EventLoopThreadPool选择IO线程，可在任意线程读取，读到的是近似值
+    // 连接在分配时（主线程中创建TcpConnection时）即计入，避免一批连接都分到同一个线程
+    // 当前连接数
+    int activeConnections() const { return activeConnections_.load(std::memory_order_relaxed); }
+    // 所有连接输出队列中尚未发出的字节数
+    int64_t pendingOutputBytes() const { return pendingOutputBytes_.load(std::memory_order_relaxed); }
+    // 每轮事件处理耗时的滑动平均（微秒），反映新事件需要等待多久；空闲时随时间衰减
+    int64_t loopLatency() const;
+
+    // 更新负载计数器：连接分配到本线程时由TcpServer计入，连接销毁时由TcpConnection扣除
+    void connectionAdded() { activeConnections_.fetch_add(1, std::memory_order_relaxed); }
+    void connectionRemoved() { activeConnections_.fetch_sub(1, std::memory_order_relaxed); }
+    void addPendingOutputBytes(int64_t delta) {
+        pendingOutputBytes_.fetch_add(delta, std::memory_order_relaxed);
+    }
 
 private:
+    // 待执行的回调：队列的链接嵌在对象中，由EventLoop在执行后释放
+    // 不超过一定大小的对象从当前线程缓存的内存中分配，释放时放回释放线程的缓存，见event_loop.cpp
+    struct Task : MpscNode {
+        virtual ~Task() {}
+        virtual void run() = 0;
+
+        static void* operator new(size_t size);
+        static void operator delete(void* p, size_t size);
+    };
+
+    template <typename F>
+    struct FunctorTask : Task {
+        template <typename G>
+        explicit FunctorTask(G&& g) : fn(std::forward<G>(g)) {}
+        void run() override { fn(); }
+
+        F fn;
+    };
+
+    // 任务入队，必要时唤醒IO线程；可在任意线程调用
+    void queueTask(Task* task);
+
     // 处理唤醒事件
     void handleRead();
 
     // 执行所有待处理的回调
     void doPendingFunctors();
 
+    // 把本轮登记的Channel修改应用到Poller，最终事件与已注册的相同时不更新注册
+    void applyChannelUpdates();
+
     // 检查是否在创建线程中
     void abortNotInLoopThread();
 
+    // 滑动平均在空闲idleUs微秒后的值：每个半衰期减半
+    static int64_t decayedLatency(int64_t latency, int64_t idleUs);
+
     // 成员变量
     std::atomic<bool> looping_;
     std::atomic<bool> quit_;
     std::atomic<bool> callingPendingFunctors_;
+    // 已写eventfd但尚未处理，期间的queueInLoop不再重复写
+    std::atomic<bool> wakeupPending_;
     const pthread_t threadId_;
     int wakeupFd_;
-    std::unique_ptr<Epoller> poller_;
+    std::unique_ptr<Poller> poller_;
+    // 关注的事件已修改、等待更新到Poller的Channel
+    // 须先于timerQueue_构造、后于它析构：TimerQueue在构造和析构时都会修改自己的Channel
+    std::vector<Channel*> dirtyChannels_;
+    std::unique_ptr<TimerQueue> timerQueue_;
     std::unique_ptr<Channel> wakeupChannel_;
-    TaskQueue pendingFunctors_;
-    std::mutex mutex_;
+    MpscQueue<Task> pendingFunctors_;           // 跨线程提交的回调，无锁入队
+    std::vector<Task*> runningFunctors_;        // 本轮执行的回调，复用容量
     
     // 活跃的Channel列表
     std::vector<Channel*> activeChannels_;
+
+    // 负载计数器
+    std::atomic<int> activeConnections_;
+    std::atomic<int64_t> pendingOutputBytes_;
+    std::atomic<int64_t> loopLatency_;
+    std::atomic<int64_t> loopLatencyTime_;      // 最近一次采样的时间（微秒）
 };
 
 #endif // EVENT_LOOP_H
\ No newline at end of file
@@ -14,8 +14,10 @@ class EventLoopThread {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
+    // name为线程名称；cpu>=0时线程绑定到该CPU，并在绑定之后才创建EventLoop，
+    // 使Epoller、Channel、缓冲区等分配在该CPU所在的NUMA节点上
     explicit EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(),
-                            const std::string& name = "");
+                            const std::string& name = "", int cpu = -1);
     ~EventLoopThread();
 
     // 启动线程并返回EventLoop指针
@@ -33,6 +35,15 @@ private:
     std::condition_variable cond_;
     ThreadInitCallback callback_;
     std::string name_;
+    int cpu_;
+};
+
+// 新连接分配到IO线程的策略
+enum class DispatchPolicy {
+    kRoundRobin,        // 轮询
+    kLeastConnections,  // 当前连接数最少
+    kLeastPendingBytes, // 输出队列中待发送字节数最少，适合长时间的大文件下载
+    kLeastLatency       // 事件处理耗时最短
 };
 
 class EventLoopThreadPool {
@@ -50,10 +61,21 @@ public:
     // 设置线程数
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
 
+    // 获取线程数
+    int threadNum() const { return numThreads_; }
+
+    // 设置IO线程绑定的CPU，第i个线程绑定到cpus[i % cpus.size()]；为空时不绑定
+    // 可用physicalCoreCpus()为每个物理核心分配一个线程；需在start()之前设置
+    void setThreadCpus(const std::vector<int>& cpus) { cpus_ = cpus; }
+
     // 启动线程池
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
-    // 获取下一个EventLoop（轮询方式）
+    // 设置分配策略，默认轮询
+    void setDispatchPolicy(DispatchPolicy policy) { policy_ = policy; }
+    DispatchPolicy dispatchPolicy() const { return policy_; }
+
+    // 按分配策略获取下一个EventLoop
     EventLoop* getNextLoop();
 
     // 获取所有EventLoop
@@ -66,12 +88,17 @@ public:
     const std::string& name() const { return name_; }
 
 private:
+    // 从start开始查找按当前策略负载最小的EventLoop下标
+    size_t leastLoaded(size_t start) const;
+
     // 成员变量
     EventLoop* baseLoop_; // 主线程的EventLoop
     std::string name_;
     bool started_;
     int numThreads_;
-    int next_; // 轮询索引
+    int next_; // 轮询索引，负载相同时也从这里开始比较
+    DispatchPolicy policy_;
+    std::vector<int> cpus_; // IO线程绑定的CPU
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
 };
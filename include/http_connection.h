@@ -1,103 +1,97 @@
 #ifndef HTTP_CONNECTION_H
 #define HTTP_CONNECTION_H
 
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <fcntl.h>
 #include <string>
 #include <memory>
 #include <unordered_map>
 #include <vector>
+#include "buffer.h"
+#include "http_request.h"
+#include "open_file_cache.h"
+#include "static_file_cache.h"
 
-// HTTP请求方法
-enum class HttpMethod {
-    GET,
-    POST,
-    HEAD,
-    PUT,
-    DELETE,
-    OPTIONS,
-    TRACE,
-    CONNECT,
-    UNKNOWN
-};
-
-// HTTP请求解析状态
-enum class HttpRequestParseState {
-    REQUEST_LINE,
-    HEADERS,
-    BODY,
-    FINISH
-};
-
+// HTTP会话：只负责解析请求和生成响应，不直接读写套接字
+// 输入来自调用方的缓冲区（TcpConnection的inputBuffer_），响应由调用方取走后发送
 class HttpConnection : public std::enable_shared_from_this<HttpConnection> {
 public:
-    HttpConnection(int sockfd);
+    HttpConnection();
     ~HttpConnection();
 
-    // 处理HTTP请求
-    bool process();
-    
-    // 读取数据
-    ssize_t read(int* savedErrno);
+    // 从input中解析并处理一个HTTP请求，处理完成后消费该请求占用的字节
+    // NEED_MORE：请求尚不完整；COMPLETE：已生成响应；ERROR：已生成错误响应
+    HttpRequest::ParseResult process(Buffer* input);
     
-    // 获取响应头
-    const std::string &getResponse() const { return responseHeader_; }
-    
-    // 写入数据
-    ssize_t write(int* savedErrno);
-    
-    // 关闭连接
-    void close();
+    // 获取响应的各个数据段：状态行和响应头、响应体、可选的尾部
+    const std::string &getResponseHeader() const { return responseHeader_; }
+    const std::string &getResponseBody() const { return responseBody_; }
+    const std::string &getResponseTrailer() const { return responseTrailer_; }
+
+    // 转移响应数据段的所有权（用于交给TcpConnection分段发送，避免拷贝）
+    void takeResponse(std::string* header, std::string* body, std::string* trailer);
+
+    // 响应体来自静态文件缓存时返回缓存项并转移所有权；否则返回空指针
+    StaticFileCache::EntryPtr takeResponseContent();
+
+    // 响应体为文件（通过sendfile发送）时返回文件并转移所有权；否则返回空指针
+    OpenFileCache::FilePtr takeResponseFile();
     
-    // 重置连接状态
+    // 重置请求状态，为下一个请求做准备
     void reset();
     
-    // 追加缓冲区数据
-    void appendBuffer(const std::string& data) { readBuffer_ += data; }
-    
     // 是否正在处理
     bool isProcessing() const { return isProcessing_; }
 
+    // 是否已收到请求的一部分，但请求头尚不完整
+    bool readingHeaders() const { return request_.started() && !request_.headersComplete(); }
+
+    // 本次响应后是否需要关闭连接（Connection头、HTTP版本、请求数上限）
+    bool isClose() const { return isClose_; }
+
+    // 设置单个连接上允许处理的最大请求数（<=0表示不限制）
+    void setMaxRequests(int maxRequests) { maxRequests_ = maxRequests; }
+
+    // 当前连接上已处理的请求数
+    int requestCount() const { return requestCount_; }
+
+    // 最近一个请求的方法、路径和响应状态码（用于访问日志）
+    const std::string& requestMethod() const { return requestMethod_; }
+    const std::string& requestPath() const { return requestPath_; }
+    int responseStatus() const { return responseStatus_; }
+
+    static const int kDefaultMaxRequests = 100;
+
 private:
-    // 解析请求相关方法
-    bool parseRequest();
-    bool parseRequestLine(const std::string &line);
-    bool parseHeaders(const std::string &line);
-    bool parseBody(const std::string &body);
-    
     // 生成响应相关方法
     void generateResponse();
     void generateErrorResponse(int statusCode, const std::string &message);
     
     // 文件处理相关方法
-    bool readFile(const std::string& filePath, std::string& content);
     bool handleStaticFile();
     bool handleApiRequest();
     
     // 辅助方法
-    bool getFileExtension(const std::string& path, std::string& extension);
-    std::string getMimeType(const std::string& extension);
+    void updateKeepAlive();
+    const char* connectionHeader() const;
 
-    int sockfd_;                             // 套接字描述符
-    struct sockaddr_in addr_;                // 地址信息
-    std::string readBuffer_;                 // 读取缓冲区
     bool isProcessing_;                      // 是否正在处理
     bool isClose_;                           // 是否关闭
+    int maxRequests_;                        // 单连接最大请求数
+    int requestCount_;                       // 已处理的请求数
     
     // 响应相关
-    std::string responseHeader_;             // 响应头
+    std::string responseHeader_;             // 状态行和响应头
+    std::string responseBody_;               // 响应体
+    std::string responseTrailer_;            // 尾部（可选）
+    StaticFileCache::EntryPtr responseContent_;  // 响应体（静态文件缓存中的内容）
+    OpenFileCache::FilePtr responseFile_;    // 响应体文件（通过sendfile发送）
+    int responseStatus_;                     // 响应状态码
+
+    // 请求的方法和路径，在请求字节被消费前拷贝（复用容量，keep-alive时不再分配）
+    std::string requestMethod_;
+    std::string requestPath_;
     
     // HTTP请求解析相关
-    HttpRequestParseState parseState_;       // 解析状态
-    HttpMethod method_;                      // 请求方法
-    std::string path_;                       // 请求路径
-    std::string version_;                    // HTTP版本
-    std::string body_;                       // 请求体
-    std::unordered_map<std::string, std::string> headers_; // 请求头
-    std::unordered_map<std::string, std::string> queryParams_; // 查询参数
+    HttpRequest request_;                    // 增量解析器，字段指向输入缓冲区
 };
 
 #endif // HTTP_CONNECTION_H
\ No newline at end of file
@@ -1,18 +1,27 @@
 #ifndef HTTP_REQUEST_H
-#define HTTP_REQUEST_H 
+#define HTTP_REQUEST_H
 
 #include <string>
-#include <regex>
+#include <vector>
 #include <unordered_map>
 #include "buffer.h"
+#include "string_piece.h"
 
+// 增量式HTTP请求解析器
+// 直接在Buffer上解析，不拷贝数据；请求行和请求头以相对于buffer->peek()的偏移记录，
+// 因此在请求完整到达之前Buffer扩容、搬移数据都不会使已解析的结果失效。
+// 解析完成后，getter返回的StringPiece指向Buffer内部，在Buffer被retrieve之前有效。
 class HttpRequest {
 public:
     enum class HttpMethod {
         GET,
         POST,
+        HEAD,
         PUT,
         DELETE,
+        OPTIONS,
+        TRACE,
+        CONNECT,
         UNKNOWN
     };
     enum class HttpRequestParseState {
@@ -21,41 +30,97 @@ public:
         BODY,
         FINISH
     };
+    enum class ParseResult {
+        NEED_MORE,  // 数据不完整，等待更多数据
+        COMPLETE,   // 已解析出一个完整请求
+        ERROR       // 请求格式错误
+    };
+
+    // 请求头（请求行+头部）的最大长度
+    static const size_t kMaxHeaderSize = 8 * 1024;
+    // 请求体的最大长度
+    static const size_t kMaxBodySize = 8 * 1024 * 1024;
 
     HttpRequest();
     ~HttpRequest() = default;
 
-    bool parse(const std::shared_ptr<Buffer>& buffer);  // 解析HttpRequest
+    // 从buffer可读区域的起始位置增量解析一个请求，不消费buffer中的数据。
+    // 可在每次有新数据到达时重复调用，会从上次停下的位置继续。
+    ParseResult parse(const Buffer* buffer);
 
-    // 重置请求
+    // 重置请求，准备解析下一个请求
     void reset();
 
+    // 完整请求（含请求体）占用的字节数，COMPLETE之后有效
+    size_t requestLength() const { return parsedBytes_; }
+
+    // 是否已开始接收请求（已有数据但请求尚未完整）
+    bool started() const { return started_; }
+
+    // 请求行和请求头是否已全部解析
+    bool headersComplete() const {
+        return state_ == HttpRequestParseState::BODY || state_ == HttpRequestParseState::FINISH;
+    }
+
     // Getter方法
     HttpMethod getMethod() const { return method_; }
-    const std::string& getPath() const { return path_; }
-    const std::string& getVersion() const { return version_; }
-    const std::string& getBody() const { return body_; }
-    const std::unordered_map<std::string, std::string>& getHeaders() const { return headers_; }
-    const std::unordered_map<std::string, std::string>& getQueryParams() const { return queryParams_; }
-    const std::unordered_map<std::string, std::string>& getPostData() const { return post_; }
+    StringPiece getMethodString() const { return piece(methodSlice_); }
+    StringPiece getPath() const { return piece(pathSlice_); }
+    StringPiece getQuery() const { return piece(querySlice_); }
+    StringPiece getVersion() const { return piece(versionSlice_); }
+    StringPiece getBody() const { return piece(bodySlice_); }
+    // 查找请求头（忽略大小写），不存在时返回空片段
+    StringPiece getHeader(const StringPiece& name) const;
+    bool hasHeader(const StringPiece& name) const;
+    size_t headerCount() const { return headers_.size(); }
+    StringPiece headerName(size_t i) const { return piece(headers_[i].name); }
+    StringPiece headerValue(size_t i) const { return piece(headers_[i].value); }
+
+    // 解析application/x-www-form-urlencoded格式的数据（查询串、表单）
+    static void parseUrlEncoded(const StringPiece& data,
+                                std::unordered_map<std::string, std::string>* params);
 
 private:
+    // 相对于buffer->peek()的片段
+    struct Slice {
+        size_t offset;
+        size_t length;
+    };
+
+    struct Header {
+        Slice name;
+        Slice value;
+    };
+
     // 解析函数
-    bool parseRequestLine(const std::string& line);  // 解析请求行
-    bool parseHeaders(const std::string& line);      // 解析请求头
-    bool parseBody(const std::string& body);         // 解析请求体
-    void parsePath(const std::string& fullPath);     // 解析路径
+    bool parseRequestLine(const char* begin, const char* end);  // 解析请求行
+    bool parseHeader(const char* begin, const char* end);       // 解析请求头
+
+    Slice makeSlice(const char* begin, const char* end) const {
+        Slice slice = { static_cast<size_t>(begin - base_), static_cast<size_t>(end - begin) };
+        return slice;
+    }
+
+    StringPiece piece(const Slice& slice) const {
+        return base_ ? StringPiece(base_ + slice.offset, slice.length) : StringPiece();
+    }
 
 private:
     HttpMethod method_;                              // 请求方法
-    std::string path_;                               // 请求路径
-    std::string version_;                            // HTTP版本
-    std::string body_;                               // 原始请求体
     HttpRequestParseState state_;                    // 当前解析状态
-    std::unordered_map<std::string, std::string> queryParams_;  // URL查询参数
-    std::unordered_map<std::string, std::string> headers_;      // 请求头
-    std::unordered_map<std::string, std::string> post_;         // POST请求数据
-    std::string readBuffer_;                         // 读取的缓冲区内容
+    const char* base_;                               // 当前解析时buffer->peek()
+    size_t parsedBytes_;                             // 已解析完成的字节数
+    size_t scannedBytes_;                            // 已扫描过（不含换行）的字节数
+    size_t contentLength_;                           // 请求体长度
+    bool hasContentLength_;                          // 是否已出现Content-Length
+    bool hasTransferEncoding_;                       // 是否已出现Transfer-Encoding
+    bool started_;                                   // 是否已收到请求数据
+    Slice methodSlice_;
+    Slice pathSlice_;
+    Slice querySlice_;
+    Slice versionSlice_;
+    Slice bodySlice_;
+    std::vector<Header> headers_;                    // 请求头
 };
 
-#endif
\ No newline at end of file
+#endif
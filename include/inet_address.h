@@ -18,6 +18,9 @@ public:
     // 获取字符串表示的IP:端口
     std::string toIpPort() const;
 
+    // 把IP:端口写入buf（不分配内存），返回写入的长度
+    size_t formatIpPort(char* buf, size_t size) const;
+
     // 获取端口号
     uint16_t port() const;
 
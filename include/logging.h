@@ -0,0 +1,127 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <string>
+#include <cstring>
+#include <stdint.h>
+
+// 日志级别
+enum class LogLevel {
+    kTrace = 0,
+    kDebug = 1,
+    kInfo = 2,
+    kWarn = 3,
+    kError = 4,
+    kFatal = 5
+};
+
+// 编译期最低日志级别（LogLevel的数值），低于它的日志语句不生成任何代码
+// 默认保留DEBUG，运行时再由Logger::setLogLevel()过滤；发布版本可定义为2去掉DEBUG日志
+#ifndef LOG_ACTIVE_LEVEL
+#define LOG_ACTIVE_LEVEL 1
+#endif
+
+// 单行日志的格式化缓冲区，在栈上，不分配内存；超长的内容被截断，结尾的换行总能写入
+class LogStream {
+public:
+    static const size_t kBufferSize = 4000;
+
+    LogStream() : len_(0) {}
+
+    // 禁止拷贝构造和赋值
+    LogStream(const LogStream&) = delete;
+    LogStream& operator=(const LogStream&) = delete;
+
+    LogStream& operator<<(bool v) { return append(v ? "1" : "0", 1); }
+    LogStream& operator<<(char v) { return append(&v, 1); }
+    LogStream& operator<<(short v) { return formatInteger(static_cast<long long>(v)); }
+    LogStream& operator<<(unsigned short v) { return formatInteger(static_cast<unsigned long long>(v)); }
+    LogStream& operator<<(int v) { return formatInteger(static_cast<long long>(v)); }
+    LogStream& operator<<(unsigned int v) { return formatInteger(static_cast<unsigned long long>(v)); }
+    LogStream& operator<<(long v) { return formatInteger(static_cast<long long>(v)); }
+    LogStream& operator<<(unsigned long v) { return formatInteger(static_cast<unsigned long long>(v)); }
+    LogStream& operator<<(long long v) { return formatInteger(v); }
+    LogStream& operator<<(unsigned long long v) { return formatInteger(v); }
+    LogStream& operator<<(float v) { return *this << static_cast<double>(v); }
+    LogStream& operator<<(double v);
+    LogStream& operator<<(const void* p);
+    LogStream& operator<<(const char* s) {
+        return s ? append(s, strlen(s)) : append("(null)", 6);
+    }
+    LogStream& operator<<(const std::string& s) { return append(s.data(), s.size()); }
+
+    LogStream& append(const char* data, size_t len) {
+        // 保留最后一个字节给finish()写入的换行
+        if (len > kBufferSize - 1 - len_) {
+            len = kBufferSize - 1 - len_;
+        }
+        memcpy(data_ + len_, data, len);
+        len_ += len;
+        return *this;
+    }
+
+    // 以换行结束一行日志，之后不再追加
+    void finish() { data_[len_++] = '\n'; }
+
+    const char* data() const { return data_; }
+    size_t length() const { return len_; }
+
+private:
+    LogStream& formatInteger(long long v);
+    LogStream& formatInteger(unsigned long long v);
+
+    char data_[kBufferSize];
+    size_t len_;
+};
+
+// 一条日志：构造时写入时间、线程号和级别，析构时加上源文件位置并交给输出函数
+// 默认输出函数直接write到标准错误；AsyncLogging::start()之后改为写入后台线程的缓冲区
+class Logger {
+public:
+    typedef void (*OutputFunc)(const char* msg, size_t len);
+    typedef void (*FlushFunc)();
+
+    // saveErrno为true时在末尾附加errno对应的错误信息
+    Logger(const char* file, int line, LogLevel level, bool saveErrno = false);
+    ~Logger();
+
+    // 禁止拷贝构造和赋值
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    LogStream& stream() { return stream_; }
+
+    // 运行时日志级别，默认kInfo
+    static LogLevel logLevel() { return s_logLevel_; }
+    static void setLogLevel(LogLevel level) { s_logLevel_ = level; }
+
+    static void setOutput(OutputFunc out);
+    static void setFlush(FlushFunc flush);
+
+private:
+    static LogLevel s_logLevel_;
+
+    LogStream stream_;
+    LogLevel level_;
+    const char* file_;
+    int line_;
+    int savedErrno_;
+};
+
+// 编译期被去掉的级别展开为永不执行的分支，参数仍做类型检查
+#define LOG_IMPL(level, saveErrno) \
+    if (static_cast<int>(level) < LOG_ACTIVE_LEVEL || level < Logger::logLevel()) {} \
+    else Logger(__FILE__, __LINE__, level, saveErrno).stream()
+
+#define LOG_TRACE LOG_IMPL(LogLevel::kTrace, false)
+#define LOG_DEBUG LOG_IMPL(LogLevel::kDebug, false)
+#define LOG_INFO  LOG_IMPL(LogLevel::kInfo, false)
+#define LOG_WARN  LOG_IMPL(LogLevel::kWarn, false)
+#define LOG_ERROR LOG_IMPL(LogLevel::kError, false)
+// 输出日志后刷新并abort()
+#define LOG_FATAL Logger(__FILE__, __LINE__, LogLevel::kFatal, false).stream()
+// 附加errno的错误信息
+#define LOG_SYSERR LOG_IMPL(LogLevel::kError, true)
+#define LOG_SYSFATAL Logger(__FILE__, __LINE__, LogLevel::kFatal, true).stream()
+
+#endif // LOGGING_H
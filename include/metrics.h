@@ -0,0 +1,89 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// 运行指标：按状态码的请求数、收发字节数、接受的连接数、每个IO线程打开的连接数和请求处理耗时
+// 每个线程只写自己的分片，分片中的值只由所属线程修改，更新时不需要原子的读改写指令；
+// 抓取时（/api/metrics）合并所有分片，以Prometheus文本格式输出。
+// 耗时直方图按对数线性分桶（HDR风格）：每个2的幂区间再等分为16个子桶，相对误差不超过1/16。
+class Metrics {
+public:
+    // 计数器，只增不减，输出所有线程之和
+    enum Counter {
+        kConnectionsAccepted,   // 接受的连接数
+        kBytesReceived,         // 从套接字读入的字节数
+        kBytesSent,             // 响应的字节数（响应头和响应体）
+        kCounterCount
+    };
+
+    // 仪表，可增可减；每个分片的值是所属线程的贡献，按线程输出
+    // （连接的建立和销毁都在所属IO线程中进行，因此即为每个IO线程上的值）
+    enum Gauge {
+        kOpenConnections,       // 打开的连接数
+        kGaugeCount
+    };
+
+    // 直方图分桶：小于16的值各占一个桶，之后每个2的幂区间16个桶
+    static const int kSubBucketBits = 4;
+    static const int kSubBucketCount = 1 << kSubBucketBits;
+    static const int kMaxExponent = 40;  // 2^40微秒约12.7天，更大的值计入最后一个桶
+    static const int kBucketCount = (kMaxExponent - kSubBucketBits + 1) * kSubBucketCount;
+
+    // 全局唯一的指标注册表
+    static Metrics& instance();
+
+    // 禁止拷贝构造和赋值
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // 以下方法只修改当前线程的分片，可在任意线程调用
+    void increment(Counter counter, uint64_t n = 1);
+    void adjust(Gauge gauge, int64_t delta);
+
+    // 记录一个已完成的请求：响应状态码和处理耗时（微秒）
+    void recordRequest(int status, int64_t durationMicroSeconds);
+
+    // 合并所有分片，以Prometheus文本格式追加到out
+    void writePrometheus(std::string* out);
+
+    // 值所在的桶，以及桶内的最大值
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+
+private:
+    static const int kMinStatus = 100;
+    static const int kMaxStatus = 599;
+    static const int kStatusSlots = kMaxStatus - kMinStatus + 2;  // 最后一个位置记录范围外的状态码
+
+    // 每个线程的分片；只有所属线程写入，抓取线程用relaxed读取
+    struct Shard {
+        Shard();
+
+        std::string thread;                              // 线程名，作为仪表的标签
+        std::atomic<uint64_t> counters[kCounterCount];
+        std::atomic<int64_t> gauges[kGaugeCount];
+        std::atomic<uint64_t> statusCounts[kStatusSlots];
+        std::atomic<uint64_t> buckets[kBucketCount];
+        std::atomic<uint64_t> durationSum;               // 耗时总和（微秒）
+    };
+    typedef std::shared_ptr<Shard> ShardPtr;
+
+    Metrics() {}
+
+    // 当前线程的分片，首次使用时登记
+    Shard* threadShard();
+
+    // 线程退出后分片仍保留在shards_中，计数器不会因线程退出而回退
+    static thread_local ShardPtr t_shard_;
+
+    std::mutex mutex_;
+    std::vector<ShardPtr> shards_;
+};
+
+#endif // METRICS_H
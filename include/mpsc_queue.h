@@ -0,0 +1,80 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+
+// 侵入式队列的链接，入队的对象继承它
+struct MpscNode {
+    std::atomic<MpscNode*> mpscNext;
+
+    MpscNode() : mpscNext(nullptr) {}
+};
+
+// 侵入式无锁多生产者单消费者队列（基于Dmitry Vyukov的侵入式链表队列）
+// 链接嵌在入队的对象中（T继承MpscNode），队列本身不分配内存，对象由调用方创建和释放；
+// 同一个对象出队之前不能再次入队。
+// 任意线程都可以push，只有一个线程（EventLoop所在线程）可以pop；push只有一次原子exchange，不会阻塞。
+// 注意：生产者在exchange之后、链接next之前被挂起时，消费者会暂时看不到它及之后的对象，
+// pop返回nullptr；调用方需保证该生产者完成push后会再次通知消费者（见EventLoop::queueTask）。
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue()
+        : head_(&stub_),
+          tail_(&stub_) {}
+
+    // 禁止拷贝构造和赋值
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // 入队，可在任意线程调用
+    void push(T* node) {
+        link(node);
+    }
+
+    // 出队，只能在消费者线程调用；队列为空（或生产者尚未完成入队）时返回nullptr
+    T* pop() {
+        MpscNode* tail = tail_;
+        MpscNode* next = tail->mpscNext.load(std::memory_order_acquire);
+        // 跳过哨兵节点
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->mpscNext.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        // tail是最后一个对象：有生产者正在入队时等它完成，否则放回哨兵节点后取出tail
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        link(&stub_);
+        next = tail->mpscNext.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        return nullptr;
+    }
+
+private:
+    void link(MpscNode* node) {
+        node->mpscNext.store(nullptr, std::memory_order_relaxed);
+        MpscNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->mpscNext.store(node, std::memory_order_release);
+    }
+
+    // head_和tail_之间填充一个缓存行，生产者和消费者互不干扰
+    // （C++11的new不保证alignas超过16字节的对齐，与AccessLog一样不用alignas）
+    std::atomic<MpscNode*> head_;  // 最近入队的对象，生产者竞争
+    char padding_[64];
+    MpscNode* tail_;               // 下一个出队的对象，只由消费者访问
+    MpscNode stub_;                // 哨兵节点，队列为空时head_和tail_指向它
+};
+
+#endif // MPSC_QUEUE_H
@@ -0,0 +1,104 @@
+#ifndef OPEN_FILE_CACHE_H
+#define OPEN_FILE_CACHE_H
+
+#include <sys/types.h>
+#include <time.h>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <atomic>
+
+// 打开文件描述符及文件信息缓存（类似nginx的open_file_cache），所有IO线程共享
+// 缓存普通文件的描述符、长度、修改时间，以及目录/普通文件类型；
+// 不存在的路径同样缓存（负缓存），重复的404请求不再访问文件系统。
+// 缓存项在有效期内直接使用，过期后用一次stat核对，文件未变化时继续沿用已打开的描述符。
+class OpenFileCache {
+public:
+    // 文件信息；描述符在最后一个引用释放时关闭
+    // sendfile使用显式偏移，不改变文件位置，同一描述符可以被多个连接同时使用
+    class File {
+    public:
+        ~File();
+
+        bool exists() const { return error_ == 0; }
+        int error() const { return error_; }
+        bool isRegular() const;
+        bool isDirectory() const;
+        // 仅普通文件有描述符，其他情况为-1
+        int fd() const { return fd_; }
+        off_t size() const { return size_; }
+        time_t mtime() const { return mtime_; }
+        ino_t inode() const { return inode_; }
+
+    private:
+        friend class OpenFileCache;
+
+        File() : fd_(-1), error_(0), mode_(0), size_(0), mtime_(0), inode_(0) {}
+
+        int fd_;
+        int error_;         // 打开或stat失败时的errno
+        mode_t mode_;
+        off_t size_;
+        time_t mtime_;
+        ino_t inode_;
+    };
+    typedef std::shared_ptr<const File> FilePtr;
+
+    // 默认有效期（秒）
+    static const int kDefaultValidity = 10;
+    // 默认最大缓存项数
+    static const size_t kDefaultMaxEntries = 1024;
+
+    static OpenFileCache& instance();
+
+    // 打开path并返回文件信息，不会返回空指针；文件不存在时exists()为false
+    FilePtr open(const std::string& path);
+
+    // 设置有效期（秒），<=0表示不缓存，每次都重新打开
+    void setValidity(int seconds);
+    // 设置最大缓存项数，超出时按LRU淘汰
+    void setMaxEntries(size_t maxEntries);
+    void clear();
+
+private:
+    static const size_t kNumShards = 16;
+
+    struct Node {
+        std::string path;
+        FilePtr file;
+        time_t validUntil;
+    };
+    // LRU链表头部为最近使用的项
+    typedef std::list<Node> LruList;
+
+    struct Shard {
+        std::mutex mutex;
+        LruList lru;
+        std::unordered_map<std::string, LruList::iterator> index;
+        size_t maxEntries;
+
+        Shard() : maxEntries(0) {}
+    };
+
+    OpenFileCache();
+    OpenFileCache(const OpenFileCache&) = delete;
+    OpenFileCache& operator=(const OpenFileCache&) = delete;
+
+    Shard& shardFor(const std::string& path) {
+        return shards_[std::hash<std::string>()(path) % kNumShards];
+    }
+
+    // 打开文件并获取文件信息
+    static FilePtr openFile(const std::string& path);
+    // 用stat核对缓存项是否仍与文件系统一致
+    static bool isFresh(const std::string& path, const File& file);
+
+    void evict(Shard& shard);
+
+    std::atomic<int> validity_;
+    Shard shards_[kNumShards];
+};
+
+#endif // OPEN_FILE_CACHE_H
@@ -0,0 +1,69 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+
+class Buffer;
+class Channel;
+struct msghdr;
+
+// IO多路复用的接口，EventLoop通过它等待事件、更新Channel关注的事件
+// 默认使用epoll（Epoller）；设置了环境变量WEBSERVER_USE_URING且内核支持时使用io_uring（UringPoller），
+// 不支持时回退到epoll
+//
+// 完成模式（只有UringPoller支持）：Poller代为接受连接、接收和发送数据，
+// 操作完成后把结果保存起来，以可读（接受、接收）或可写（发送）事件通知Channel，事件回调再用take*()取出结果。
+// 不支持时supportsCompletions()返回false、各操作返回false，调用方照常使用就绪通知、自己读写套接字。
+// 使用完成模式的Channel同样通过removeChannel()移除，尚未完成的操作随之撤销。
+class Poller {
+public:
+    using ChannelList = std::vector<Channel*>;
+
+    Poller() {}
+    virtual ~Poller() {}
+
+    // 禁止拷贝构造和赋值
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    // 等待事件发生，把活跃的Channel追加到activeChannels，返回活跃的Channel数
+    virtual int poll(int timeoutMs, ChannelList* activeChannels) = 0;
+
+    // 按Channel当前关注的事件更新注册
+    virtual void updateChannel(Channel* channel) = 0;
+
+    // 移除Channel
+    virtual void removeChannel(Channel* channel) = 0;
+
+    // 检查Channel是否在Poller中
+    virtual bool hasChannel(Channel* channel) = 0;
+
+    // 后端名称，用于日志
+    virtual const char* name() const = 0;
+
+    // 是否支持完成模式
+    virtual bool supportsCompletions() const { return false; }
+
+    // 在监听套接字上持续接受连接
+    virtual bool startAccepting(Channel*) { return false; }
+    // 取出已接受的连接描述符，返回期间遇到的错误（errno），没有错误时返回0
+    virtual int takeAccepted(Channel*, std::vector<int>*) { return 0; }
+
+    // 持续接收数据，收到的数据追加到buffer中；buffer在Channel移除之前必须有效
+    virtual bool startReceiving(Channel*, Buffer*) { return false; }
+    // 取出接收结果：返回追加到buffer的字节数，对方已关闭时*eof为true，出错时*error为errno
+    virtual size_t takeReceived(Channel*, bool*, int*) { return 0; }
+
+    // 提交发送请求，同一时刻每个Channel最多一个。msg及其指向的数据在完成之前必须有效：
+    // 完成之前（包括Channel移除之后）Poller一直持有owner
+    virtual bool submitSend(Channel*, const struct msghdr*, const std::shared_ptr<void>&) { return false; }
+    // 发送请求已完成时取出结果并返回true，*result为发送的字节数或-errno
+    virtual bool takeSendResult(Channel*, ssize_t*) { return false; }
+
+    // 按环境变量和内核支持情况创建Poller，在EventLoop所在线程调用
+    static Poller* newDefaultPoller();
+};
+
+#endif // POLLER_H
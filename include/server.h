@@ -29,6 +29,26 @@ public:
     void setSignalHandler();
     
 private:
+    // 连接：HTTP会话以及套接字的读写缓冲区（HttpConnection本身不读写套接字）
+    struct Connection {
+        HttpConnection http;
+        Buffer input;                    // 已读取、尚未解析的请求数据
+        Buffer output;                   // 尚未发送的响应头和响应体
+        OpenFileCache::FilePtr file;     // 响应体文件，output发送完后通过sendfile发送
+        off_t fileOffset;                // 文件已发送的字节数
+
+        Connection() : fileOffset(0) {}
+    };
+
+    // 读取套接字中的全部数据，返回读到的字节数；出错时返回-1并设置savedErrno
+    static ssize_t readConnection(int sockFd, Connection* conn, int* savedErrno);
+
+    // 取出会话生成的响应，放入连接的发送缓冲区
+    static void takeResponse(Connection* conn);
+
+    // 发送响应直到全部发完或套接字不可写，返回是否已全部发送；出错时设置savedErrno
+    static bool writeConnection(int sockFd, Connection* conn, int* savedErrno);
+
     // 初始化服务器套接字
     bool initSocket();
     
@@ -57,7 +77,7 @@ private:
     std::unique_ptr<Epoll> epoll_;
     
     // HTTP连接映射
-    std::unordered_map<int, std::unique_ptr<HttpConnection>> connections_;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
     
     // 服务器是否运行
     bool isRunning_;
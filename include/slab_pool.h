@@ -0,0 +1,101 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+// 定长对象池：按块（slab）向系统申请内存，每块切分为若干等长的槽，释放的槽挂在空闲链表上复用，
+// 频繁创建和销毁的对象（如连接）不再每次经过malloc。
+// 槽的大小在第一次分配时确定，之后大小不同的请求直接使用operator new。
+// 分配和释放可在任意线程进行（由互斥锁保护）。每个EventLoop一个池时，连接在所属IO线程中创建，
+// 通常也在该线程释放，锁基本不会竞争；但其他线程持有的shared_ptr（如跨线程send）可能最后释放，
+// 这时归还发生在那个线程，所以不能去掉锁。
+class SlabPool {
+public:
+    static const size_t kDefaultSlotsPerSlab = 64;
+
+    explicit SlabPool(size_t slotsPerSlab = kDefaultSlotsPerSlab);
+    ~SlabPool();
+
+    // 禁止拷贝构造和赋值
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+
+    // 已申请的块数和正在使用的槽数
+    size_t slabCount() const;
+    size_t slotsInUse() const;
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    mutable std::mutex mutex_;
+    const size_t slotsPerSlab_;
+    size_t slotSize_;                 // 0表示尚未确定
+    size_t slotsInUse_;
+    FreeSlot* freeList_;
+    std::vector<char*> slabs_;
+};
+
+typedef std::shared_ptr<SlabPool> SlabPoolPtr;
+
+// 从SlabPool分配内存的分配器，供std::allocate_shared使用。
+// 单个对象（如shared_ptr的控制块连同对象本身）从池中分配，数组直接使用operator new。
+// 分配器持有池的引用，控制块中保存一份，控制块释放之前池不会被销毁。
+template <typename T>
+class SlabAllocator {
+public:
+    typedef T value_type;
+
+    explicit SlabAllocator(const SlabPoolPtr& pool) : pool_(pool) {}
+
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>& other) : pool_(other.pool()) {}
+
+    T* allocate(size_t n) {
+        if (n == 1) {
+            return static_cast<T*>(pool_->allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n == 1) {
+            pool_->deallocate(p, sizeof(T));
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    const SlabPoolPtr& pool() const { return pool_; }
+
+private:
+    SlabPoolPtr pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const SlabAllocator<T>& lhs, const SlabAllocator<U>& rhs) {
+    return lhs.pool() == rhs.pool();
+}
+
+template <typename T, typename U>
+bool operator!=(const SlabAllocator<T>& lhs, const SlabAllocator<U>& rhs) {
+    return !(lhs == rhs);
+}
+
+// 从SlabPool创建对象：控制块和对象一起放在池的一个槽中，创建时不经过malloc。
+// 最后一个shared_ptr释放时析构对象，最后一个weak_ptr也释放后槽才归还给池。
+template <typename T, typename... Args>
+std::shared_ptr<T> makeSlabShared(const SlabPoolPtr& pool, Args&&... args) {
+    return std::allocate_shared<T>(SlabAllocator<T>(pool), std::forward<Args>(args)...);
+}
+
+#endif // SLAB_POOL_H
@@ -0,0 +1,100 @@
+#ifndef STATIC_FILE_CACHE_H
+#define STATIC_FILE_CACHE_H
+
+#include <sys/types.h>
+#include <time.h>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include "open_file_cache.h"
+
+// 进程级静态文件内容缓存，所有IO线程共享
+// 按文件路径分段加锁（lock striping），不同文件的查找互不竞争；
+// 每个分段维护自己的LRU链表和字节预算。
+// 可缓存的文件用pread读入内存，超过上限的文件不缓存（由调用方走sendfile）。
+// 不使用mmap：文件被原地截断（如cp覆盖）后，仍在发送映射内容的响应会触发SIGBUS。
+// 文件的打开和有效性核对交给OpenFileCache，本缓存只比对文件信息决定是否重新加载。
+class StaticFileCache {
+public:
+    // 缓存项：文件内容及预先生成的Content-Type、Content-Length
+    // 通过shared_ptr共享，被淘汰后仍在发送中的响应依然持有有效的内容
+    class Entry {
+    public:
+        const char* data() const { return content_.data(); }
+        size_t size() const { return content_.size(); }
+        const std::string& mimeType() const { return mimeType_; }
+        // "Content-Type: ...\r\nContent-Length: ...\r\n"
+        const std::string& headerFields() const { return headerFields_; }
+
+    private:
+        friend class StaticFileCache;
+
+        Entry() : mtime_(0), inode_(0) {}
+
+        std::string content_;       // 文件内容
+        std::string mimeType_;
+        std::string headerFields_;
+        time_t mtime_;              // 加载时文件的修改时间
+        ino_t inode_;               // 加载时文件的inode
+    };
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    // 可缓存的文件上限
+    static const size_t kMaxCachedFileSize = 4 * 1024 * 1024;
+    // 默认总字节预算
+    static const size_t kDefaultCapacity = 64 * 1024 * 1024;
+
+    static StaticFileCache& instance();
+
+    // 查找path对应的文件内容，未命中或与file不一致（文件已修改）时从file加载
+    // file不是普通文件或超过可缓存上限时返回空指针
+    EntryPtr get(const std::string& path, const OpenFileCache::FilePtr& file);
+
+    // 设置总字节预算，超出部分在后续插入时淘汰
+    void setCapacity(size_t bytes);
+
+    // 清空缓存
+    void clear();
+
+    // 根据文件扩展名获取MIME类型
+    static std::string mimeType(const std::string& path);
+
+private:
+    static const size_t kNumShards = 16;
+
+    // LRU链表头部为最近使用的项
+    typedef std::list<std::pair<std::string, EntryPtr> > LruList;
+
+    struct Shard {
+        std::mutex mutex;
+        LruList lru;
+        std::unordered_map<std::string, LruList::iterator> index;
+        size_t bytes;
+        size_t capacity;
+
+        Shard() : bytes(0), capacity(0) {}
+    };
+
+    StaticFileCache();
+    StaticFileCache(const StaticFileCache&) = delete;
+    StaticFileCache& operator=(const StaticFileCache&) = delete;
+
+    Shard& shardFor(const std::string& path) {
+        return shards_[std::hash<std::string>()(path) % kNumShards];
+    }
+
+    // 从已打开的文件加载内容
+    static EntryPtr load(const std::string& path, const OpenFileCache::File& file);
+    // 检查缓存项是否与文件一致（修改时间、inode、长度）
+    static bool isFresh(const Entry& entry, const OpenFileCache::File& file);
+
+    void insert(Shard& shard, const std::string& path, const EntryPtr& entry);
+    void evict(Shard& shard);
+
+    Shard shards_[kNumShards];
+};
+
+#endif // STATIC_FILE_CACHE_H
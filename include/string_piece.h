@@ -0,0 +1,49 @@
+#ifndef STRING_PIECE_H
+#define STRING_PIECE_H
+
+#include <string>
+#include <cstring>
+#include <strings.h>
+
+// 指向外部内存的只读字符串片段，不拥有数据，也不做拷贝
+class StringPiece {
+public:
+    StringPiece() : ptr_(nullptr), length_(0) {}
+    StringPiece(const char* str) : ptr_(str), length_(strlen(str)) {}
+    StringPiece(const char* ptr, size_t len) : ptr_(ptr), length_(len) {}
+    StringPiece(const std::string& str) : ptr_(str.data()), length_(str.size()) {}
+
+    const char* data() const { return ptr_; }
+    size_t size() const { return length_; }
+    bool empty() const { return length_ == 0; }
+    const char* begin() const { return ptr_; }
+    const char* end() const { return ptr_ + length_; }
+
+    char operator[](size_t i) const { return ptr_[i]; }
+
+    // 转换为std::string（会拷贝数据）
+    std::string toString() const { return std::string(ptr_, length_); }
+
+    bool operator==(const StringPiece& rhs) const {
+        return length_ == rhs.length_ && memcmp(ptr_, rhs.ptr_, length_) == 0;
+    }
+
+    bool operator!=(const StringPiece& rhs) const {
+        return !(*this == rhs);
+    }
+
+    // 忽略大小写比较
+    bool equalsIgnoreCase(const StringPiece& rhs) const {
+        return length_ == rhs.length_ && strncasecmp(ptr_, rhs.ptr_, length_) == 0;
+    }
+
+    bool startsWith(const StringPiece& prefix) const {
+        return length_ >= prefix.length_ && memcmp(ptr_, prefix.ptr_, prefix.length_) == 0;
+    }
+
+private:
+    const char* ptr_;
+    size_t length_;
+};
+
+#endif // STRING_PIECE_H
@@ -4,11 +4,18 @@
 #include "inet_address.h"
 #include "channel.h"
 #include "socket.h"
+#include "buffer.h"
+#include "http_connection.h"
+#include "timestamp.h"
 #include <memory>
 #include <string>
+#include <deque>
 #include <functional>
+#include <stdint.h>
 
 class EventLoop;
+class Poller;
+class TimingWheel;
 
 class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 public:
@@ -17,10 +24,22 @@ public:
     using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
     using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
     using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
-    using MessageCallback = std::function<void(const TcpConnectionPtr&, std::string*)>;
+    using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer*)>;
 
-    TcpConnection(EventLoop* loop, const std::string& nameArg, int sockfd,
-                 const InetAddress& localAddr, const InetAddress& peerAddr);
+    // 回调函数由同一服务器的所有连接共享，创建连接时只增加引用计数，不再逐个拷贝
+    struct Callbacks {
+        ConnectionCallback connection;
+        MessageCallback message;
+        WriteCompleteCallback writeComplete;
+        HighWaterMarkCallback highWaterMark;
+        CloseCallback close;
+    };
+    using CallbacksPtr = std::shared_ptr<const Callbacks>;
+
+    // id由TcpServer的连接表分配（槽位下标和代数），见TcpServer::createConnection()
+    TcpConnection(EventLoop* loop, uint64_t id, int sockfd,
+                 const InetAddress& localAddr, const InetAddress& peerAddr,
+                 const CallbacksPtr& callbacks);
     ~TcpConnection();
 
     // 禁止拷贝构造和赋值
@@ -30,8 +49,8 @@ public:
     // 获取EventLoop
     EventLoop* getLoop() const { return loop_; }
 
-    // 获取连接名称
-    const std::string& name() const { return name_; }
+    // 获取连接id
+    uint64_t id() const { return id_; }
 
     // 获取本地地址和对端地址
     const InetAddress& localAddress() const { return localAddr_; }
@@ -46,6 +65,21 @@ public:
     // 发送数据
     void send(const void* message, int len);
     void send(const std::string& message);
+
+    // 分段发送（如响应头、响应体、尾部），各段不拼接，通过writev聚合写出
+    // 调用方转移数据段的所有权，未写完的部分直接挂在输出队列上，不做拷贝
+    void sendSegments(std::string&& header, std::string&& body,
+                      std::string&& trailer = std::string());
+
+    // 发送共享的只读数据（如静态文件缓存中的内容），不拷贝数据
+    // owner保证data在发送完成前有效
+    void sendShared(std::string&& header, const std::shared_ptr<const void>& owner,
+                    const char* data, size_t len);
+
+    // 发送文件：先发送header，再用sendfile从页缓存直接发送文件中[offset, offset+count)的内容
+    // fd由owner持有，发送完成前保持打开；未发送完的部分在handleWrite中续传
+    void sendFile(std::string&& header, const std::shared_ptr<const void>& owner,
+                  int fd, off_t offset, size_t count);
     
     // 关闭连接
     void shutdown();
@@ -53,27 +87,26 @@ public:
     // 强制关闭连接
     void forceClose();
     
-    // 设置回调函数
-    void setConnectionCallback(const ConnectionCallback& cb) {
-        connectionCallback_ = cb;
-    }
-    
-    void setMessageCallback(const MessageCallback& cb) {
-        messageCallback_ = cb;
-    }
-    
-    void setWriteCompleteCallback(const WriteCompleteCallback& cb) {
-        writeCompleteCallback_ = cb;
-    }
-    
-    void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark) {
-        highWaterMarkCallback_ = cb;
-        highWaterMark_ = highWaterMark;
-    }
-    
-    void setCloseCallback(const CloseCallback& cb) {
-        closeCallback_ = cb;
-    }
+    // 待发送字节数达到该值时调用高水位回调
+    void setHighWaterMark(size_t highWaterMark) { highWaterMark_ = highWaterMark; }
+
+    // 设置keep-alive连接上允许处理的最大请求数
+    void setMaxKeepAliveRequests(int maxRequests);
+
+    // 空闲超时：最近一次成功读写后超过seconds秒关闭连接（<=0表示不限制）
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+    // 请求头读取超时：开始接收请求后超过seconds秒请求头仍不完整则关闭连接（<=0表示不限制）
+    void setHeaderTimeout(double seconds) { headerTimeout_ = seconds; }
+
+    // 边沿触发模式：读写到EAGAIN为止（每次事件有预算），可写事件一直开启；需在connectEstablished()之前设置
+    // Poller支持完成模式（io_uring）时由Poller接收和发送数据，不使用边沿触发
+    void setEdgeTriggered(bool on) { channel_.setEdgeTriggered(on); }
+
+    // 由时间轮检查超时，连接建立后在IO线程中加入
+    void setTimingWheel(const std::shared_ptr<TimingWheel>& wheel) { timingWheel_ = wheel; }
+
+    // 当前的超时截止时间，没有超时限制时返回无效的Timestamp
+    Timestamp deadline() const;
     
     // 连接建立
     void connectEstablished();
@@ -82,7 +115,7 @@ public:
     void connectDestroyed();
     
     // 获取socket文件描述符
-    int getFd() const { return socket_->fd(); }
+    int getFd() const { return socket_.fd(); }
 
 private:
     enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
@@ -94,9 +127,62 @@ private:
     void handleWrite();
     void handleClose();
     void handleError();
+
+    // 处理输入缓冲区中的请求
+    void processInput(Timestamp now);
+
+    // 边沿触发时预算用完后，在本轮事件处理之后继续读写
+    void resumeRead();
+    void resumeWrite();
+
+    // 是否有数据等待可写事件：水平触发时看是否关注可写事件，边沿触发时看待发送的字节数，
+    // 完成模式时看是否有发送请求未完成或数据未提交
+    bool writing() const {
+        if (completionPoller_ != nullptr) {
+            return sendInFlight_ || pendingOutputBytes() > 0;
+        }
+        return channel_.edgeTriggered() ? pendingOutputBytes() > 0 : channel_.isWriting();
+    }
+    // 发送时能否直接写套接字：没有待发送的数据，且不是完成模式（完成模式下统一提交发送请求）
+    bool canWriteDirectly() const {
+        return completionPoller_ == nullptr && !writing() && pendingOutputBytes() == 0;
+    }
+    // 有数据待发送 / 已全部发出；水平触发时开关可写事件，边沿触发时不更新Poller
+    void startWriting();
+    void stopWriting();
     
     // 发送缓冲区数据
     void sendInLoop(const void* message, size_t len);
+    void sendSegmentsInLoop(std::string* header, std::string* body, std::string* trailer);
+    void sendSharedInLoop(std::string* header, const std::shared_ptr<const void>& owner,
+                          const char* data, size_t len);
+    void sendFileInLoop(std::string* header, const std::shared_ptr<const void>& owner,
+                        int fd, off_t offset, size_t count);
+
+    // 写出输出缓冲区和队首的内存数据段 / 队首的文件数据段
+    ssize_t writeMemoryChunks();
+    ssize_t writeFileChunk();
+
+    // 完成模式：收集输出缓冲区和队首的内存数据段，提交一个发送请求
+    void submitMemoryChunks();
+
+    // 完成模式的读写事件：取走Poller已接收的数据 / 取走发送结果并提交后续数据
+    void handleReadCompletion();
+    void handleWriteCompletion();
+
+    // 待发送的字节数（输出缓冲区和输出队列）
+    size_t pendingOutputBytes() const {
+        return outputBuffer_.readableBytes() + outputChunkBytes_;
+    }
+
+    // 消费已写出的n个字节
+    void retrieveOutput(size_t n);
+
+    // 把待发送字节数的变化计入所属EventLoop的负载计数器
+    void reportPendingOutput();
+
+    // 记录一条访问日志
+    void logAccess(Timestamp requestStart, Timestamp finish, size_t bytes);
     
     // 关闭连接
     void shutdownInLoop();
@@ -105,28 +191,70 @@ private:
 
     // 成员变量
     EventLoop* loop_;
-    const std::string name_;
+    const uint64_t id_;
     StateE state_;
     
-    // 套接字相关
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    // 套接字相关，与连接对象分配在一起
+    Socket socket_;
+    Channel channel_;
     
     // 地址信息
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
     
-    // 回调函数
-    ConnectionCallback connectionCallback_;
-    MessageCallback messageCallback_;
-    WriteCompleteCallback writeCompleteCallback_;
-    HighWaterMarkCallback highWaterMarkCallback_;
-    CloseCallback closeCallback_;
+    // 回调函数（服务器内共享）
+    CallbacksPtr callbacks_;
     
-    // 缓冲区和水位线
+    // 连接上的HTTP会话，跨请求复用，与连接对象分配在一起
+    HttpConnection httpConnection_;
+    
+    // 超时控制：读写只更新时间戳，由时间轮批量检查
+    friend class TimingWheel;
+    double idleTimeout_;
+    double headerTimeout_;
+    Timestamp lastActive_;                  // 最近一次成功读写的时间
+    Timestamp headerStart_;                 // 请求头超时的起点：建立连接或开始接收请求头的时间，请求头完整后清除
+    std::weak_ptr<TimingWheel> timingWheel_;
+    uint64_t wheelGeneration_;              // 每次放入时间轮递增，旧的项随之失效
+    Timestamp scheduledDeadline_;           // 在时间轮中登记的截止时间
+
+    // 缓冲区和水位线；缓冲区的存储优先取用本线程已销毁连接留下的，见tcp_connection.cpp
     size_t highWaterMark_;
-    std::string inputBuffer_;
-    std::string outputBuffer_;
+    Buffer inputBuffer_;
+    Buffer outputBuffer_;
+
+    // 输出队列：排在outputBuffer_之后发送的数据段
+    // 内存数据段：offset为已写出的字节数，即可恢复的写游标；
+    //   内容在data中，或为owner持有的外部只读内存[ref, ref+refLength)
+    // 文件数据段：fileFd>=0（由owner持有），fileOffset为文件中下一个待发送的位置，fileRemaining为剩余字节数
+    struct OutputChunk {
+        std::string data;
+        size_t offset;
+        std::shared_ptr<const void> owner;
+        const char* ref;
+        size_t refLength;
+        int fileFd;
+        off_t fileOffset;
+        size_t fileRemaining;
+
+        OutputChunk() : offset(0), ref(nullptr), refLength(0),
+                        fileFd(-1), fileOffset(0), fileRemaining(0) {}
+
+        const char* begin() const { return ref ? ref : data.data(); }
+        size_t size() const { return ref ? refLength : data.size(); }
+    };
+    std::deque<OutputChunk> outputChunks_;
+    size_t outputChunkBytes_; // 输出队列中待发送的字节数
+    size_t reportedPendingBytes_; // 已计入EventLoop负载计数器的待发送字节数
+    bool readResumeQueued_;       // 已排队继续读（边沿触发）
+    bool writeResumeQueued_;      // 已排队继续写（边沿触发、完成模式）
+
+    // 完成模式：非空时数据由Poller接收到inputBuffer_，发送数据通过Poller提交发送请求
+    // 发送请求未完成时，请求引用的数据（outputBuffer_的可读部分和队首的数据段）不能移动或释放
+    struct SendRequest;
+    Poller* completionPoller_;
+    std::unique_ptr<SendRequest> sendRequest_;
+    bool sendInFlight_;
 };
 
 #endif // TCP_CONNECTION_H
\ No newline at end of file
@@ -6,15 +6,19 @@
 #include "tcp_connection.h"
 #include "event_loop_thread_pool.h"
 #include "acceptor.h"
+#include "timing_wheel.h"
+#include "slab_pool.h"
 #include <memory>
 #include <string>
 #include <map>
 #include <functional>
+#include <vector>
+#include <atomic>
 
 class TcpServer {
 public:
     using ConnectionCallback = std::function<void(const TcpConnection::TcpConnectionPtr&)>;
-    using MessageCallback = std::function<void(const TcpConnection::TcpConnectionPtr&, std::string*)>;
+    using MessageCallback = std::function<void(const TcpConnection::TcpConnectionPtr&, Buffer*)>;
     using WriteCompleteCallback = std::function<void(const TcpConnection::TcpConnectionPtr&)>;
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
@@ -27,12 +31,21 @@ public:
     TcpServer& operator=(const TcpServer&) = delete;
 
     // 设置线程池大小
+    // 开启reuseport且线程数大于0时，每个IO线程各自持有一个绑定同一端口的Acceptor，
+    // 由内核在监听套接字之间分配连接，新连接直接在接受它的IO线程中建立，不需要跨线程转交
     void setThreadNum(int numThreads);
 
+    // 设置IO线程绑定的CPU，见EventLoopThreadPool::setThreadCpus()
+    void setThreadCpus(const std::vector<int>& cpus) { threadPool_->setThreadCpus(cpus); }
+
+    // 设置新连接分配到IO线程的策略，需在start()之前设置
+    // 每线程Acceptor模式下连接由接受它的线程处理，该设置不起作用
+    void setDispatchPolicy(DispatchPolicy policy) { threadPool_->setDispatchPolicy(policy); }
+
     // 启动服务器
     void start();
 
-    // 设置回调函数
+    // 设置回调函数，需在start()之前设置，所有连接共享
     void setConnectionCallback(const ConnectionCallback& cb) {
         connectionCallback_ = cb;
     }
@@ -49,24 +62,95 @@ public:
         threadInitCallback_ = cb;
     }
 
+    // 设置每个keep-alive连接允许处理的最大请求数（<=0表示不限制）
+    void setMaxKeepAliveRequests(int maxRequests) {
+        maxKeepAliveRequests_ = maxRequests;
+    }
+
+    // 每次监听套接字可读时最多接受的连接数；需在start()之前设置
+    void setAcceptBatch(int batch) { acceptBatch_ = batch; }
+
+    // 未开启reuseport且线程数大于0时，所有IO线程共同监听同一个套接字，
+    // 用EPOLLEXCLUSIVE避免一个连接唤醒所有线程；需在start()之前设置
+    void setExclusiveAccept(bool on) { exclusiveAccept_ = on; }
+
+    // 空闲连接超时（秒），<=0表示不限制；需在start()之前设置
+    void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+
+    // 请求头读取超时（秒），<=0表示不限制；需在start()之前设置
+    void setHeaderTimeout(double seconds) { headerTimeout_ = seconds; }
+
+    // 连接使用边沿触发（EPOLLET），读写到EAGAIN为止，可写事件一直开启；默认水平触发；需在start()之前设置
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // 超时检查的时间粒度（秒）；需在start()之前设置
+    void setTimeoutTick(double seconds) { timeoutTick_ = seconds; }
+
+    // 当前的连接数，汇总各IO线程的连接表，读到的是近似值；可在任意线程调用
+    size_t connectionCount() const;
+
+    static const int kDefaultIdleTimeout = 60;
+    static const int kDefaultHeaderTimeout = 15;
+
     // 获取连接名称
     std::string removeConnectionName(int id);
 
 private:
-    // 新连接回调
-    void newConnection(int sockfd, const InetAddress& peerAddr);
+    // 每个IO线程的连接表和连接对象池，只在该IO线程中访问（映射本身在start()时建立，之后不再改变）
+    // 连接表是按槽位下标索引的数组：连接id的低32位为槽位下标，高32位为槽位的代数，
+    // 槽位每次释放后代数加一，已移除连接的旧id不会误中复用该槽位的新连接；id在同一IO线程内唯一
+    struct ConnectionSlot {
+        TcpConnection::TcpConnectionPtr conn;
+        uint32_t generation;
+    };
+    struct LoopConnections {
+        SlabPoolPtr pool;
+        std::vector<ConnectionSlot> slots;
+        std::vector<uint32_t> freeSlots;     // 空闲的槽位下标
+        std::atomic<size_t> count;           // 连接数，供其他线程汇总
+
+        LoopConnections() : pool(std::make_shared<SlabPool>()), count(0) {}
+    };
+
+    // 新连接回调（主线程Acceptor），为一批连接选择IO线程，
+    // 每个目标IO线程只转交一次，连接对象在IO线程中创建
+    void newConnections(const Acceptor::AcceptedConnectionList& accepted);
+
+    // 新连接回调（每线程Acceptor），在ioLoop所在线程直接建立连接
+    void acceptConnections(EventLoop* ioLoop, const Acceptor::AcceptedConnectionList& accepted);
+
+    // 在ioLoop所在线程创建并建立一批连接（调用方已把它们计入ioLoop的负载）
+    void establishConnections(EventLoop* ioLoop, const Acceptor::AcceptedConnectionList& accepted);
+
+    // 创建连接对象并登记到ioLoop的连接表，尚未建立；在ioLoop所在线程调用
+    // 连接对象（含Socket、Channel和HTTP会话）连同shared_ptr控制块从ioLoop的对象池中一次分配
+    TcpConnection::TcpConnectionPtr createConnection(EventLoop* ioLoop, int sockfd,
+                                                     const InetAddress& peerAddr);
     
-    // 移除连接
+    // 移除连接，在连接所属的IO线程中调用，只访问该线程的连接表
     void removeConnection(const TcpConnection::TcpConnectionPtr& conn);
-    
-    // 在IO线程中移除连接
-    void removeConnectionInLoop(const TcpConnection::TcpConnectionPtr& conn);
+
+    // 在ioLoop所在线程销毁它的所有连接并停止时间轮（服务器析构时）
+    void destroyLoopConnections(EventLoop* ioLoop);
+
+    // 按id在ioLoop的连接表中查找连接，已移除时返回nullptr；供时间轮使用，在ioLoop所在线程调用
+    TcpConnection* findConnection(EventLoop* ioLoop, uint64_t id) const;
+
+    // 是否为每个IO线程创建SO_REUSEPORT监听套接字
+    bool perLoopAcceptors() const;
+
+    // 是否所有IO线程共享监听套接字（EPOLLEXCLUSIVE）
+    bool sharedAcceptors() const;
 
     // 成员变量
     EventLoop* loop_;                                  // 主事件循环
     const std::string name_;                           // 服务器名称
     const InetAddress listenAddr_;                     // 监听地址
-    std::unique_ptr<Acceptor> acceptor_;               // 接受器
+    const bool reuseport_;                             // 是否开启SO_REUSEPORT
+    std::unique_ptr<Acceptor> acceptor_;               // 接受器（主线程）
+    std::vector<std::unique_ptr<Acceptor> > loopAcceptors_; // 每个IO线程的接受器
+    int acceptBatch_;                                  // 每次唤醒最多接受的连接数
+    bool exclusiveAccept_;                             // 是否共享监听套接字
     std::unique_ptr<EventLoopThreadPool> threadPool_;  // 线程池
     
     // 回调函数
@@ -75,10 +159,20 @@ private:
     WriteCompleteCallback writeCompleteCallback_;      // 写完成回调
     ThreadInitCallback threadInitCallback_;            // 线程初始化回调
     
-    // 连接管理
-    std::map<std::string, TcpConnection::TcpConnectionPtr> connections_; // 连接映射
+    // 所有连接共享的回调，start()时生成
+    TcpConnection::CallbacksPtr connectionCallbacks_;
+
+    // 连接管理，每个IO线程一份
+    std::map<EventLoop*, std::unique_ptr<LoopConnections> > loopConnections_;
     bool started_;                                     // 是否启动
-    int nextConnId_;                                   // 下一个连接ID
+    int maxKeepAliveRequests_;                         // 单连接最大请求数
+
+    // 超时控制，每个IO线程一个时间轮
+    double idleTimeout_;
+    double headerTimeout_;
+    double timeoutTick_;
+    bool edgeTriggered_;                               // 连接是否使用边沿触发
+    std::map<EventLoop*, std::shared_ptr<TimingWheel> > timingWheels_;
 };
 
 #endif // TCP_SERVER_H
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef THREAD_AFFINITY_H
+#define THREAD_AFFINITY_H
+
+#include <string>
+#include <vector>
+
+// 设置当前线程名称，perf/top/gdb中可见；超过15个字符时截断
+void setCurrentThreadName(const std::string& name);
+
+// 把当前线程绑定到指定CPU，并让它之后分配的内存优先放在该CPU所在的NUMA节点
+// 应在线程分配自己的数据结构之前调用：Linux按首次访问的线程所在节点分配物理页
+bool bindCurrentThreadToCpu(int cpu);
+
+// CPU所在的NUMA节点，不支持NUMA或无法确定时返回-1
+int cpuNumaNode(int cpu);
+
+// 每个物理核心取一个逻辑CPU（跳过超线程的兄弟CPU），按CPU编号排序
+// 适合作为IO线程的CPU列表：每个物理核心一个EventLoop
+std::vector<int> physicalCoreCpus();
+
+#endif // THREAD_AFFINITY_H
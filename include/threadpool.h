@@ -10,13 +10,16 @@
 #include <future>
 #include <memory>
 #include <atomic>
+#include <string>
 
 class ThreadPool {
 public:
     using Task = std::function<void()>;
 
     // 构造函数，创建指定数量的线程
-    explicit ThreadPool(size_t threadCount = 4);
+    // 线程命名为name加序号；cpus非空时第i个线程绑定到cpus[i % cpus.size()]
+    explicit ThreadPool(size_t threadCount = 4, const std::string& name = "worker",
+                        const std::vector<int>& cpus = std::vector<int>());
     
     // 析构函数，等待所有线程完成
     ~ThreadPool();
@@ -31,10 +34,14 @@ public:
 
 private:
     // 工作线程函数
-    void workerThread();
+    void workerThread(size_t index);
     
     // 线程池状态
     std::atomic<bool> stop_;
+
+    // 线程名称前缀和绑定的CPU
+    std::string name_;
+    std::vector<int> cpus_;
     
     // 线程列表
     std::vector<std::thread> workers_;
@@ -0,0 +1,60 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <functional>
+#include <atomic>
+#include <stdint.h>
+#include "timestamp.h"
+
+// 定时器：到期时间、回调，以及可选的重复间隔
+class Timer {
+public:
+    using TimerCallback = std::function<void()>;
+
+    Timer(TimerCallback cb, Timestamp when, double interval, int64_t sequence)
+        : callback_(std::move(cb)),
+          expiration_(when),
+          interval_(interval),
+          repeat_(interval > 0.0),
+          sequence_(sequence) {}
+
+    // 禁止拷贝构造和赋值
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 重复定时器以now为起点计算下一次到期时间
+    void restart(Timestamp now) { expiration_ = addTime(now, interval_); }
+
+    // 分配全局唯一的定时器序号，可在任意线程调用
+    static int64_t nextSequence() { return ++s_numCreated_; }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_;
+    const bool repeat_;
+    const int64_t sequence_;
+
+    static std::atomic<int64_t> s_numCreated_;
+};
+
+// 定时器标识，用于取消定时器
+class TimerId {
+public:
+    TimerId() : sequence_(0) {}
+    explicit TimerId(int64_t sequence) : sequence_(sequence) {}
+
+    bool valid() const { return sequence_ > 0; }
+    int64_t sequence() const { return sequence_; }
+
+private:
+    int64_t sequence_;
+};
+
+#endif // TIMER_H
@@ -0,0 +1,71 @@
+#ifndef TIMER_QUEUE_H
+#define TIMER_QUEUE_H
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "channel.h"
+#include "timer.h"
+#include "timestamp.h"
+
+class EventLoop;
+
+// 定时器队列：每个EventLoop一个timerfd，注册为Channel，定时器回调在所属的IO线程中执行
+// 到期时间保存在最小堆中，timerfd始终设置为堆顶的到期时间。
+// 取消定时器只从定时器表中删除，堆中对应的项在到达堆顶时被跳过（惰性删除）。
+// 内部的到期时间使用单调时钟（CLOCK_MONOTONIC），timerfd按绝对时间设置，
+// 修改系统时间不会让定时器提前或推迟触发。
+class TimerQueue {
+public:
+    using TimerCallback = Timer::TimerCallback;
+
+    explicit TimerQueue(EventLoop* loop);
+    ~TimerQueue();
+
+    // 禁止拷贝构造和赋值
+    TimerQueue(const TimerQueue&) = delete;
+    TimerQueue& operator=(const TimerQueue&) = delete;
+
+    // 添加定时器，interval>0时重复执行，可在任意线程调用
+    // when为系统时间（Timestamp::now()），添加时换算为单调时钟的到期时间
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+    // 取消定时器，可在任意线程调用；已取消或已到期的定时器忽略
+    void cancel(TimerId timerId);
+
+private:
+    // 堆中的项：到期时间和定时器序号，序号相同时按先后顺序
+    typedef std::pair<Timestamp, int64_t> Entry;
+    typedef std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > TimerHeap;
+
+    void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+
+    // timerfd可读时调用，执行所有到期的定时器
+    void handleRead();
+
+    // 插入定时器，返回它是否成为最早到期的定时器
+    bool insert(std::unique_ptr<Timer> timer);
+
+    // 弹出堆顶已取消的项，并按新的堆顶重新设置timerfd
+    void resetTimerfd();
+
+    // 已取消的项过多时重建堆
+    void compact();
+
+    EventLoop* loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+    TimerHeap heap_;
+    // 有效的定时器，按序号索引
+    std::unordered_map<int64_t, std::unique_ptr<Timer> > timers_;
+    // 正在执行到期回调时，回调中取消的重复定时器不再重新加入
+    bool callingExpiredTimers_;
+    std::set<int64_t> cancelingTimers_;
+};
+
+#endif // TIMER_QUEUE_H
@@ -0,0 +1,65 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include "timer.h"
+#include "timestamp.h"
+
+class EventLoop;
+class TcpConnection;
+
+// 时间轮：每个IO线程一个，批量回收空闲或请求读取过慢的连接
+// 每个格子保存连接id，到期时通过连接表查找连接，时间轮不持有连接，也不延长连接的生命周期。
+// 连接的读写只更新连接自身的时间戳（O(1)，不访问时间轮）；
+// 格子到期时再检查连接的实际截止时间，未到期的连接重新放入对应的格子（惰性重排），
+// 已到期的连接调用forceClose()。
+class TimingWheel : public std::enable_shared_from_this<TimingWheel> {
+public:
+    static const int kDefaultBuckets = 64;
+
+    // 按连接id查找连接，连接已移除时返回nullptr；在所属IO线程调用
+    typedef std::function<TcpConnection*(uint64_t id)> ConnectionResolver;
+
+    // tickSeconds为时间粒度，numBuckets个格子覆盖tickSeconds*numBuckets秒，
+    // 更远的截止时间先放入最远的格子，到期后再重新放置
+    TimingWheel(EventLoop* loop, const ConnectionResolver& resolver,
+                double tickSeconds, int numBuckets = kDefaultBuckets);
+    ~TimingWheel();
+
+    // 禁止拷贝构造和赋值
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    // 启动时间轮，可在任意线程调用
+    void start();
+
+    // 停止时间轮，丢弃所有项，之后不再查找连接；必须在所属IO线程调用
+    void stop();
+
+    // 按连接当前的截止时间放入时间轮，之前放入的项自动失效；必须在所属IO线程调用
+    void schedule(TcpConnection* conn);
+
+    EventLoop* getLoop() const { return loop_; }
+
+private:
+    struct Entry {
+        uint64_t connId;
+        uint64_t generation;  // 与连接当前的generation不一致时说明已被重新放置
+    };
+    typedef std::vector<Entry> Bucket;
+
+    void onTick();
+    void insert(TcpConnection* conn, Timestamp deadline, Timestamp now);
+
+    EventLoop* loop_;
+    ConnectionResolver resolver_;
+    const int64_t tickMicroSeconds_;
+    std::vector<Bucket> buckets_;
+    size_t cursor_;
+    TimerId timerId_;
+};
+
+#endif // TIMING_WHEEL_H
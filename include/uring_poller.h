@@ -0,0 +1,183 @@
+#ifndef URING_POLLER_H
+#define URING_POLLER_H
+
+#include "poller.h"
+#include <map>
+#include <memory>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// 基于io_uring的Poller，直接使用io_uring_setup/io_uring_enter系统调用，不依赖liburing
+// 就绪通知（与Epoller相同的接口）用poll请求代替epoll_ctl和epoll_wait：
+//   水平触发的Channel使用单次poll，事件交付后在下一次等待前重新提交，提交时内核会立即检查就绪状态；
+//   边沿触发的Channel使用多次触发的poll（IORING_POLL_ADD_MULTI），注册一次持续产生完成事件。
+// 完成模式（见Poller）：
+//   接受连接使用多次触发的accept，一次提交持续产生新连接；
+//   接收数据使用多次触发的recv，数据由内核写入预先提供的缓冲区（provided buffers），
+//   读取完成事件时拷贝到Channel的接收缓冲区并立即归还（归还请求同样只写入提交队列）；
+//   发送数据提交sendmsg请求，同一轮中所有连接的发送请求与等待合并为一次io_uring_enter。
+// 注册、修改、移除和IO请求都只写入提交队列，与下一次等待合并为一次io_uring_enter；
+// 完成队列中已有事件时直接读取，不进入内核。
+// 就绪通知需要Linux 5.13及以上（多次触发的poll、带超时参数的io_uring_enter），不满足时create()返回nullptr；
+// 完成模式还需要6.0及以上（多次触发的accept和recv），不满足时只使用就绪通知
+class UringPoller : public Poller {
+public:
+    // 创建失败（内核不支持、io_uring被禁用等）时返回nullptr
+    static UringPoller* create();
+
+    ~UringPoller() override;
+
+    int poll(int timeoutMs, ChannelList* activeChannels) override;
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+    bool hasChannel(Channel* channel) override;
+
+    const char* name() const override { return "io_uring"; }
+
+    bool supportsCompletions() const override { return receiveBuffers_ != nullptr; }
+    bool startAccepting(Channel* channel) override;
+    int takeAccepted(Channel* channel, std::vector<int>* fds) override;
+    bool startReceiving(Channel* channel, Buffer* buffer) override;
+    size_t takeReceived(Channel* channel, bool* eof, int* error) override;
+    bool submitSend(Channel* channel, const struct msghdr* msg,
+                    const std::shared_ptr<void>& owner) override;
+    bool takeSendResult(Channel* channel, ssize_t* result) override;
+
+private:
+    // 请求的类型，保存在user_data的最高字节
+    enum Op { kOpPoll = 0, kOpAccept = 1, kOpReceive = 2, kOpSend = 3 };
+
+    // fd对应的注册状态；请求的user_data为(类型 << 56) | (代数 << 32) | fd，
+    // 撤销请求或移除Channel后代数加一，旧请求的完成事件（包括fd被重用之后到达的）都会被忽略
+    struct Entry {
+        Channel* channel;
+        uint32_t generation;        // Channel移除或被替换时加一，用于完成模式的请求
+        bool active;                // 本轮是否已加入活跃列表
+        uint32_t revents;           // 本轮合并的就绪事件
+
+        // 就绪通知
+        uint32_t events;            // 期望关注的事件（poll掩码）
+        uint32_t pollGeneration;    // poll请求每次撤销时加一
+        bool armed;                 // 内核中是否有当前代数的poll请求
+        bool multishot;             // 是否为多次触发的poll（边沿触发）
+
+        // 完成模式：接受连接
+        bool accepting;             // 是否持续接受连接
+        bool acceptArmed;           // 内核中是否有accept请求
+        std::vector<int> accepted;  // 已接受、尚未取走的连接
+        int acceptError;
+
+        // 完成模式：接收数据
+        Buffer* receiveBuffer;      // 接收缓冲区，nullptr表示不接收
+        bool receiveArmed;          // 内核中是否有recv请求
+        size_t received;            // 已追加到接收缓冲区、尚未取走的字节数
+        bool eof;
+        int receiveError;
+
+        // 完成模式：发送数据
+        bool sending;               // 内核中是否有发送请求
+        bool sendDone;              // 发送请求已完成、结果尚未取走
+        ssize_t sendResult;
+        std::shared_ptr<void> sendOwner;
+
+        Entry();
+    };
+
+    UringPoller();
+
+    // 映射提交队列和完成队列，失败时返回false
+    bool setup();
+
+    // 检查内核是否支持完成模式，分配接收数据用的缓冲区并提供给内核，失败时返回false（只使用就绪通知）
+    bool setupReceiveBuffers();
+
+    // 登记Channel，返回其注册状态
+    Entry& attach(Channel* channel);
+
+    // 撤销fd上所有的请求，清除注册状态
+    void detach(int fd, Entry& entry);
+
+    // 按Channel当前关注的事件调整poll请求
+    void apply(int fd, Entry& entry, Channel* channel);
+
+    // 提交poll请求 / 撤销poll请求（只写入提交队列）
+    void arm(int fd, Entry& entry);
+    void disarm(int fd, Entry& entry);
+
+    // 提交完成模式的请求
+    void armAccept(int fd, Entry& entry);
+    void armReceive(int fd, Entry& entry);
+
+    // 撤销user_data对应的请求
+    void cancel(uint64_t userData);
+
+    // 把[bufferId, bufferId+count)的接收缓冲区提供给内核（只写入提交队列）
+    void provideBuffers(unsigned bufferId, unsigned count);
+
+    // 取一个空闲的提交队列项，队列满时先提交已有的请求
+    struct io_uring_sqe* getSqe();
+
+    // 提交队列中的请求并按需等待完成事件
+    int enter(unsigned minComplete, int timeoutMs);
+
+    // 读取完成队列中的所有事件
+    int harvest(ChannelList* activeChannels);
+
+    // 处理完成模式请求的完成事件，返回需要通知Channel的事件
+    uint32_t complete(int fd, Entry& entry, Op op, const struct io_uring_cqe& cqe);
+
+    // 加入本轮的活跃列表
+    void activate(int fd, Entry& entry, uint32_t revents);
+
+    Entry* findEntry(int fd) {
+        return fd >= 0 && static_cast<size_t>(fd) < channels_.size() ? &channels_[fd] : nullptr;
+    }
+
+    static const unsigned kRingEntries = 256;
+    static const unsigned kCompletionEntries = 4096;
+    static const size_t kInitChannelTableSize = 64;
+    // 接收缓冲区的块数和每块的大小，每个IO线程一组
+    static const unsigned kReceiveBufferCount = 512;
+    static const size_t kReceiveBufferSize = 8 * 1024;
+
+    int ringFd_;
+
+    // 提交队列
+    void* sqRing_;
+    size_t sqRingSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    struct io_uring_sqe* sqes_;
+    size_t sqesSize_;
+    unsigned sqLocalTail_;          // 已填写、尚未对内核可见的队尾
+    unsigned toSubmit_;             // 尚未提交的请求数
+
+    // 完成队列（内核支持单次映射时与提交队列共用一段映射）
+    void* cqRing_;
+    size_t cqRingSize_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    // 各块接收缓冲区的内存，nullptr表示不支持完成模式
+    char* receiveBuffers_;
+
+    // fd到注册状态的映射，按fd下标索引
+    std::vector<Entry> channels_;
+    std::vector<int> rearm_;        // 单次poll已交付，需要在下一次等待前重新提交的fd
+    std::vector<int> restart_;      // 多次触发的accept/recv被内核终止，需要重新提交的fd
+    std::vector<int> activeFds_;    // 本轮活跃的fd，复用容量
+
+    // Channel移除时仍未完成的发送请求：完成之前继续持有owner，保证数据有效
+    std::map<uint64_t, std::shared_ptr<void> > retiredSends_;
+    std::vector<std::shared_ptr<void> > releasedOwners_;  // 本轮完成的发送请求的owner，读完完成队列后释放
+};
+
+#endif // URING_POLLER_H
@@ -1,10 +1,31 @@
 #include "acceptor.h"
+#include "logging.h"
 #include "event_loop.h"
-#include <iostream>
+#include "poller.h"
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 #include <cassert>
+#include <sys/socket.h>
+
+const int Acceptor::kDefaultAcceptBatch;
+
+namespace {
+    // 完成模式下accept不返回对端地址（多次触发的accept共用一块地址缓冲区），单独获取
+    bool getPeerAddr(int sockfd, InetAddress* peerAddr) {
+        sockaddr_in6 addr6;
+        socklen_t addrlen = sizeof addr6;
+        if (::getpeername(sockfd, reinterpret_cast<sockaddr*>(&addr6), &addrlen) < 0) {
+            return false;
+        }
+        if (addr6.sin6_family == AF_INET6) {
+            peerAddr->setSockAddrInet6(addr6);
+        } else {
+            peerAddr->setSockAddrInet(*reinterpret_cast<const sockaddr_in*>(&addr6));
+        }
+        return true;
+    }
+}
 
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport)
     : loop_(loop),
@@ -12,6 +33,9 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
       acceptChannel_(loop, acceptSocket_.fd()),
       newConnectionCallback_(),
       listening_(false),
+      exclusive_(false),
+      acceptBatch_(kDefaultAcceptBatch),
+      completionPoller_(nullptr),
       idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) {
     assert(idleFd_ >= 0);
     
@@ -29,6 +53,24 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
         std::bind(&Acceptor::handleRead, this));
 }
 
+Acceptor::Acceptor(EventLoop* loop, int listenFd, bool exclusive)
+    : loop_(loop),
+      acceptSocket_(::fcntl(listenFd, F_DUPFD_CLOEXEC, 0)),
+      acceptChannel_(loop, acceptSocket_.fd()),
+      newConnectionCallback_(),
+      listening_(false),
+      exclusive_(exclusive),
+      acceptBatch_(kDefaultAcceptBatch),
+      completionPoller_(nullptr),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) {
+    assert(acceptSocket_.fd() >= 0);
+    assert(idleFd_ >= 0);
+    
+    // 设置Channel的读事件回调
+    acceptChannel_.setReadCallback(
+        std::bind(&Acceptor::handleRead, this));
+}
+
 Acceptor::~Acceptor() {
     acceptChannel_.disableAll();
     // 使用EventLoop的removeChannel()方法替代Channel的remove()方法
@@ -39,31 +81,99 @@ Acceptor::~Acceptor() {
 void Acceptor::listen() {
     loop_->assertInLoopThread();
     listening_ = true;
+    // 共享监听套接字时重复listen()只会更新backlog
     acceptSocket_.listen();
-    acceptChannel_.enableReading();
+    if (completionPoller_ != nullptr) {
+        return;
+    }
+    // Poller支持完成模式时提交一次多次触发的accept，之后新连接直接随完成事件交付
+    Poller* poller = loop_->completionPoller();
+    if (poller != nullptr && poller->startAccepting(&acceptChannel_)) {
+        completionPoller_ = poller;
+    } else if (exclusive_) {
+        acceptChannel_.enableExclusiveReading();
+    } else {
+        acceptChannel_.enableReading();
+    }
 }
 
 void Acceptor::handleRead() {
     loop_->assertInLoopThread();
-    InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if (connfd >= 0) {
-        if (newConnectionCallback_) {
-            newConnectionCallback_(connfd, peerAddr);
-        } else {
-            // 如果没有设置回调，关闭连接
-            ::close(connfd);
+    // 每次唤醒最多接受acceptBatch_个连接，监听队列取空时提前结束，
+    // 连接风暴时不必为每个连接都经历一次epoll_wait
+    accepted_.clear();
+    if (completionPoller_ != nullptr) {
+        // 连接已由内核接受，随完成事件交付
+        takeCompletedAccepts();
+    }
+    for (int i = 0; completionPoller_ == nullptr && i < acceptBatch_; ++i) {
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0) {
+            AcceptedConnection conn = { connfd, peerAddr };
+            accepted_.push_back(conn);
+            continue;
         }
-    } else {
-        // 错误处理
+
         int savedErrno = errno;
-        std::cerr << "in Acceptor::handleRead" << std::endl;
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+            // 监听队列已空（共享监听套接字时可能被其他线程取走）
+            break;
+        }
+        if (savedErrno == ECONNABORTED || savedErrno == EINTR || savedErrno == EPROTO) {
+            continue;
+        }
+        // 错误处理
+        LOG_SYSERR << "in Acceptor::handleRead";
         if (savedErrno == EMFILE) {
-            // 文件描述符耗尽，使用预先准备的idleFd_处理
-            ::close(idleFd_);
-            idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
-            ::close(idleFd_);
-            idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            handleFdExhaustion();
+        }
+        break;
+    }
+
+    if (accepted_.empty()) {
+        return;
+    }
+    if (newConnectionsCallback_) {
+        newConnectionsCallback_(accepted_);
+    } else if (newConnectionCallback_) {
+        for (const AcceptedConnection& conn : accepted_) {
+            newConnectionCallback_(conn.sockfd, conn.peerAddr);
+        }
+    } else {
+        // 如果没有设置回调，关闭连接
+        for (const AcceptedConnection& conn : accepted_) {
+            ::close(conn.sockfd);
         }
     }
-}
\ No newline at end of file
+}
+
+void Acceptor::takeCompletedAccepts() {
+    acceptedFds_.clear();
+    int error = completionPoller_->takeAccepted(&acceptChannel_, &acceptedFds_);
+    for (int connfd : acceptedFds_) {
+        InetAddress peerAddr;
+        if (!getPeerAddr(connfd, &peerAddr)) {
+            // 连接在交付前已被对端重置
+            ::close(connfd);
+            continue;
+        }
+        AcceptedConnection conn = { connfd, peerAddr };
+        accepted_.push_back(conn);
+    }
+    if (error != 0 && error != ECONNABORTED && error != EINTR && error != EPROTO) {
+        errno = error;
+        LOG_SYSERR << "in Acceptor::handleRead";
+        if (error == EMFILE || error == ENFILE) {
+            handleFdExhaustion();
+        }
+    }
+}
+
+void Acceptor::handleFdExhaustion() {
+    // 文件描述符耗尽，使用预先准备的idleFd_处理
+    ::close(idleFd_);
+    idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
+    ::close(idleFd_);
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
@@ -0,0 +1,375 @@
+#include "access_log.h"
+#include "inet_address.h"
+#include "logging.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+const size_t AccessLog::kDefaultRingSize;
+
+thread_local AccessLog::RingPtr AccessLog::t_ring_;
+
+namespace {
+    // 单条记录的最大长度，过长的路径被截断
+    const size_t kMaxRecordSize = 2048;
+    const size_t kMaxPathSize = 1024;
+
+    // 每个线程缓存当前秒的时间字符串
+    thread_local char t_time[32];
+    thread_local time_t t_lastSecond = 0;
+
+    // 向定长缓冲区追加内容，空间不足时截断
+    class RecordWriter {
+    public:
+        RecordWriter(char* buf, size_t size) : buf_(buf), size_(size), len_(0) {}
+
+        void append(const char* data, size_t len) {
+            len = std::min(len, size_ - len_);
+            memcpy(buf_ + len_, data, len);
+            len_ += len;
+        }
+        void append(const char* s) { append(s, strlen(s)); }
+        void append(char c) { append(&c, 1); }
+
+        void appendInteger(long long v) {
+            char num[32];
+            int n = snprintf(num, sizeof num, "%lld", v);
+            append(num, static_cast<size_t>(n));
+        }
+
+        // JSON字符串转义：引号、反斜杠和控制字符
+        void appendEscaped(const char* data, size_t len) {
+            for (size_t i = 0; i < len; ++i) {
+                unsigned char c = static_cast<unsigned char>(data[i]);
+                if (c == '"' || c == '\\') {
+                    append('\\');
+                    append(static_cast<char>(c));
+                } else if (c < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof esc, "\\u%04x", c);
+                    append(esc, 6);
+                } else {
+                    append(static_cast<char>(c));
+                }
+            }
+        }
+
+        size_t length() const { return len_; }
+
+    private:
+        char* buf_;
+        size_t size_;
+        size_t len_;
+    };
+
+    size_t roundUpToPowerOfTwo(size_t n) {
+        size_t size = 4096;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+}
+
+AccessLog::Ring::Ring(size_t size)
+    : data(new char[roundUpToPowerOfTwo(size)]),
+      capacity(roundUpToPowerOfTwo(size)),
+      head(0),
+      tail(0),
+      dropped(0) {
+}
+
+AccessLog& AccessLog::instance() {
+    // 不析构：IO线程可能在静态对象析构期间仍在记录
+    static AccessLog* log = new AccessLog();
+    return *log;
+}
+
+AccessLog::AccessLog()
+    : fd_(-1),
+      rotateBytes_(0),
+      rotateSeconds_(0),
+      flushInterval_(1.0),
+      fileBytes_(0),
+      running_(false),
+      reopenRequested_(false),
+      flushPending_(false) {
+}
+
+AccessLog::~AccessLog() {
+    stop();
+}
+
+bool AccessLog::start(const std::string& path) {
+    if (running_) {
+        return true;
+    }
+    path_ = path;
+    if (!openFile()) {
+        return false;
+    }
+    computeNextRotation(Timestamp::now());
+    if (flushInterval_ <= 0.0) {
+        flushInterval_ = 1.0;
+    }
+    running_ = true;
+    thread_ = std::thread(std::bind(&AccessLog::threadFunc, this));
+    return true;
+}
+
+void AccessLog::stop() {
+    if (!running_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+
+    // 停止前已进入缓冲区的记录
+    flushRings();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+AccessLog::Ring* AccessLog::threadRing() {
+    if (!t_ring_) {
+        t_ring_.reset(new Ring(kDefaultRingSize));
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(t_ring_);
+    }
+    return t_ring_.get();
+}
+
+void AccessLog::append(const Record& record) {
+    // 在栈上格式化一条记录
+    char buf[kMaxRecordSize];
+    RecordWriter writer(buf, sizeof buf - 1);
+
+    time_t seconds = static_cast<time_t>(record.time.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
+    int microSeconds = static_cast<int>(record.time.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    if (seconds != t_lastSecond) {
+        t_lastSecond = seconds;
+        struct tm tm_time;
+        gmtime_r(&seconds, &tm_time);
+        strftime(t_time, sizeof t_time, "%Y-%m-%dT%H:%M:%S", &tm_time);
+    }
+    char micro[16];
+    int n = snprintf(micro, sizeof micro, ".%06dZ", microSeconds);
+
+    char peer[64];
+    size_t peerLength = record.peer ? record.peer->formatIpPort(peer, sizeof peer) : 0;
+
+    writer.append("{\"time\":\"");
+    writer.append(t_time);
+    writer.append(micro, static_cast<size_t>(n));
+    writer.append("\",\"peer\":\"");
+    writer.append(peer, peerLength);
+    writer.append("\",\"method\":\"");
+    writer.appendEscaped(record.method.data(), record.method.size());
+    writer.append("\",\"path\":\"");
+    writer.appendEscaped(record.path.data(), std::min(record.path.size(), kMaxPathSize));
+    writer.append("\",\"status\":");
+    writer.appendInteger(record.status);
+    writer.append(",\"bytes\":");
+    writer.appendInteger(static_cast<long long>(record.bytes));
+    writer.append(",\"duration_us\":");
+    writer.appendInteger(static_cast<long long>(record.durationMicroSeconds));
+    writer.append('}');
+    size_t len = writer.length();
+    buf[len++] = '\n';
+
+    // 拷贝进本线程的环形缓冲区，写满时丢弃，不阻塞IO线程
+    Ring* ring = threadRing();
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    size_t tail = ring->tail.load(std::memory_order_acquire);
+    size_t used = head - tail;
+    if (ring->capacity - used < len) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    size_t pos = head & (ring->capacity - 1);
+    size_t first = std::min(len, ring->capacity - pos);
+    memcpy(ring->data.get() + pos, buf, first);
+    memcpy(ring->data.get(), buf + first, len - first);
+    ring->head.store(head + len, std::memory_order_release);
+
+    // 越过一半容量时提前唤醒后台线程；唤醒丢失时最多等待一个刷新间隔
+    size_t half = ring->capacity / 2;
+    if (used < half && used + len >= half && !flushPending_.exchange(true)) {
+        cond_.notify_one();
+    }
+}
+
+void AccessLog::threadFunc() {
+    while (true) {
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(flushInterval_ * 1000000)),
+                           [this]() { return flushPending_.load() || !running_; });
+            stopping = !running_;
+        }
+        flushPending_ = false;
+        flushRings();
+
+        // 先写完已缓冲的记录，再重新打开或轮转，不丢失记录
+        Timestamp now(Timestamp::now());
+        if (reopenRequested_.exchange(false)) {
+            reopen();
+        } else if ((rotateBytes_ > 0 && fileBytes_ >= rotateBytes_) ||
+                   (nextRotation_.valid() && !(now < nextRotation_))) {
+            rotate(now);
+        }
+
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+void AccessLog::flushRings() {
+    std::vector<RingPtr> rings;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings = rings_;
+    }
+
+    // 每个缓冲区的可读部分最多两段（回绕时），所有缓冲区一次writev写出
+    std::vector<struct iovec> iov;
+    std::vector<size_t> heads(rings.size());
+    size_t total = 0;
+    for (size_t i = 0; i < rings.size(); ++i) {
+        Ring* ring = rings[i].get();
+        size_t head = ring->head.load(std::memory_order_acquire);
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        heads[i] = head;
+        size_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            LOG_WARN << "AccessLog dropped " << dropped << " records";
+        }
+        if (head == tail) {
+            continue;
+        }
+        size_t len = head - tail;
+        size_t pos = tail & (ring->capacity - 1);
+        size_t first = std::min(len, ring->capacity - pos);
+        struct iovec vec;
+        vec.iov_base = ring->data.get() + pos;
+        vec.iov_len = first;
+        iov.push_back(vec);
+        if (len > first) {
+            vec.iov_base = ring->data.get();
+            vec.iov_len = len - first;
+            iov.push_back(vec);
+        }
+        total += len;
+    }
+
+    if (!iov.empty()) {
+        if (!writeFully(&iov[0], static_cast<int>(iov.size()))) {
+            // 写失败（如磁盘已满）时仍然释放缓冲区，否则IO线程会持续丢弃新记录
+            LOG_SYSERR << "AccessLog write " << path_;
+        }
+        fileBytes_ += static_cast<int64_t>(total);
+        for (size_t i = 0; i < rings.size(); ++i) {
+            rings[i]->tail.store(heads[i], std::memory_order_release);
+        }
+    }
+    rings.clear();
+
+    // 移除已退出且内容已写完的线程的缓冲区
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < rings_.size(); ) {
+        const RingPtr& ring = rings_[i];
+        if (ring.use_count() == 1 &&
+            ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed)) {
+            rings_[i] = rings_.back();
+            rings_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+bool AccessLog::writeFully(struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = ::writev(fd_, iov, std::min(iovcnt, IOV_MAX));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        // 跳过已写完的段，部分写出的段调整起点
+        size_t written = static_cast<size_t>(n);
+        while (iovcnt > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+bool AccessLog::openFile() {
+    int fd = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_SYSERR << "AccessLog open " << path_;
+        return false;
+    }
+    struct stat st;
+    fileBytes_ = ::fstat(fd, &st) == 0 ? static_cast<int64_t>(st.st_size) : 0;
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = fd;
+    return true;
+}
+
+void AccessLog::rotate(Timestamp now) {
+    // 当前文件改名为“路径.时间”，同一秒内多次轮转时追加序号
+    time_t seconds = static_cast<time_t>(now.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
+    struct tm tm_time;
+    gmtime_r(&seconds, &tm_time);
+    char suffix[32];
+    strftime(suffix, sizeof suffix, ".%Y%m%d-%H%M%S", &tm_time);
+    std::string rotated = path_ + suffix;
+    for (int i = 1; ::access(rotated.c_str(), F_OK) == 0; ++i) {
+        rotated = path_ + suffix + "." + std::to_string(i);
+    }
+    if (::rename(path_.c_str(), rotated.c_str()) < 0) {
+        LOG_SYSERR << "AccessLog rename " << path_ << " to " << rotated;
+    }
+    openFile();
+    computeNextRotation(now);
+}
+
+void AccessLog::reopen() {
+    // 文件已被外部移走或删除，打开（必要时创建）同名的新文件；打开失败时继续写旧文件
+    openFile();
+}
+
+void AccessLog::computeNextRotation(Timestamp now) {
+    if (rotateSeconds_ <= 0) {
+        nextRotation_ = Timestamp();
+        return;
+    }
+    int64_t seconds = now.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond;
+    int64_t next = (seconds / rotateSeconds_ + 1) * rotateSeconds_;
+    nextRotation_ = Timestamp(next * Timestamp::kMicroSecondsPerSecond);
+}
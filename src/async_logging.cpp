@@ -0,0 +1,231 @@
+#include "async_logging.h"
+#include "logging.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+const size_t AsyncLogging::kBufferSize;
+const size_t AsyncLogging::kMaxPendingBuffers;
+
+thread_local AsyncLogging::ThreadBufferPtr AsyncLogging::t_threadBuffer_;
+
+AsyncLogging& AsyncLogging::instance() {
+    // 不析构：其他静态对象析构时仍可能写日志
+    static AsyncLogging* logging = new AsyncLogging();
+    return *logging;
+}
+
+AsyncLogging::AsyncLogging()
+    : running_(false),
+      fd_(STDERR_FILENO),
+      ownFd_(false),
+      flushInterval_(1.0),
+      fullPending_(false) {
+}
+
+AsyncLogging::~AsyncLogging() {
+    stop();
+}
+
+bool AsyncLogging::start(const std::string& path, double flushInterval) {
+    if (running_) {
+        return true;
+    }
+    if (!path.empty()) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            LOG_SYSERR << "AsyncLogging::start open " << path;
+            return false;
+        }
+        fd_ = fd;
+        ownFd_ = true;
+    }
+    flushInterval_ = flushInterval > 0.0 ? flushInterval : 1.0;
+    running_ = true;
+    thread_ = std::thread(std::bind(&AsyncLogging::threadFunc, this));
+    Logger::setOutput(&AsyncLogging::output);
+    Logger::setFlush(&AsyncLogging::flushOutput);
+    return true;
+}
+
+void AsyncLogging::stop() {
+    if (!running_) {
+        return;
+    }
+    // 先恢复同步输出，之后的日志不再进入缓冲区
+    Logger::setOutput(nullptr);
+    Logger::setFlush(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        writeAll();
+    }
+    if (ownFd_) {
+        ::close(fd_);
+        fd_ = STDERR_FILENO;
+        ownFd_ = false;
+    }
+}
+
+AsyncLogging::ThreadBufferPtr& AsyncLogging::threadBuffer() {
+    ThreadBufferPtr& buffer = t_threadBuffer_;
+    if (!buffer) {
+        buffer.reset(new ThreadBuffer());
+        std::lock_guard<std::mutex> lock(mutex_);
+        threadBuffers_.push_back(buffer);
+    }
+    return buffer;
+}
+
+void AsyncLogging::append(const char* msg, size_t len) {
+    ThreadBufferPtr& buffer = threadBuffer();
+    bool notify = false;
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if (buffer->current->avail() < len) {
+            if (buffer->full.size() >= kMaxPendingBuffers) {
+                // 后台写不过来（如磁盘阻塞），丢弃日志而不是让IO线程阻塞或无限占用内存
+                ++buffer->dropped;
+                return;
+            }
+            buffer->full.push_back(std::move(buffer->current));
+            if (!buffer->spare.empty()) {
+                buffer->current = std::move(buffer->spare.back());
+                buffer->spare.pop_back();
+            } else {
+                buffer->current.reset(new LogBuffer());
+            }
+            notify = buffer->full.size() == 1;
+        }
+        if (len > kBufferSize) {
+            len = kBufferSize;
+        }
+        memcpy(buffer->current->data + buffer->current->length, msg, len);
+        buffer->current->length += len;
+    }
+    if (notify) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fullPending_ = true;
+        }
+        cond_.notify_one();
+    }
+}
+
+void AsyncLogging::flush() {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    writeAll();
+}
+
+void AsyncLogging::threadFunc() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(flushInterval_ * 1000000)),
+                           [this]() { return fullPending_ || !running_; });
+            fullPending_ = false;
+            if (!running_) {
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        writeAll();
+    }
+}
+
+void AsyncLogging::writeAll() {
+    std::vector<ThreadBufferPtr> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads = threadBuffers_;
+    }
+
+    for (const ThreadBufferPtr& thread : threads) {
+        writeThread(thread);
+    }
+    threads.clear();
+
+    // 移除已退出且内容已写完的线程：只剩这里的引用时不会再有线程写入
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < threadBuffers_.size(); ) {
+        const ThreadBufferPtr& thread = threadBuffers_[i];
+        if (thread.use_count() == 1 && thread->full.empty() && thread->current->length == 0) {
+            threadBuffers_[i] = threadBuffers_.back();
+            threadBuffers_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+void AsyncLogging::writeThread(const ThreadBufferPtr& thread) {
+    // 在线程缓冲区的锁内只做指针交换，写文件在锁外进行
+    std::vector<BufferPtr> toWrite;
+    size_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        toWrite.swap(thread->full);
+        if (thread->current->length > 0) {
+            toWrite.push_back(std::move(thread->current));
+            if (!thread->spare.empty()) {
+                thread->current = std::move(thread->spare.back());
+                thread->spare.pop_back();
+            } else {
+                thread->current.reset(new LogBuffer());
+            }
+        }
+        dropped = thread->dropped;
+        thread->dropped = 0;
+    }
+
+    for (const BufferPtr& buffer : toWrite) {
+        writeToFile(buffer->data, buffer->length);
+    }
+    if (dropped > 0) {
+        char msg[64];
+        int n = snprintf(msg, sizeof msg, "AsyncLogging dropped %zu log lines\n", dropped);
+        writeToFile(msg, static_cast<size_t>(n));
+    }
+
+    // 空缓冲区归还给该线程复用，最多保留两个
+    std::lock_guard<std::mutex> lock(thread->mutex);
+    for (BufferPtr& buffer : toWrite) {
+        if (thread->spare.size() >= 2) {
+            break;
+        }
+        buffer->length = 0;
+        thread->spare.push_back(std::move(buffer));
+    }
+}
+
+void AsyncLogging::writeToFile(const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+void AsyncLogging::output(const char* msg, size_t len) {
+    instance().append(msg, len);
+}
+
+void AsyncLogging::flushOutput() {
+    instance().flush();
+}
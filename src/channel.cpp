@@ -14,11 +14,14 @@ Channel::Channel(EventLoop* loop, int fd)
       fd_(fd),
       events_(kNoneEvent),
       revents_(kNoneEvent),
-      index_(-1) {
+      index_(-1),
+      edgeTriggered_(false),
+      dirtyIndex_(-1) {
 }
 
 Channel::~Channel() {
     assert(!isReading() && !isWriting());
+    assert(!dirty());
 }
 
 void Channel::handleEvent() {
@@ -44,5 +47,8 @@ void Channel::handleEvent() {
 }
 
 void Channel::update() {
-    loop_->updateChannel(this);
+    // 同一轮事件处理中的多次修改只登记一次，最终的事件在下一次poll之前一起应用
+    if (!dirty()) {
+        loop_->updateChannel(this);
+    }
 }
\ No newline at end of file
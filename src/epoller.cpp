@@ -1,18 +1,28 @@
 #include "epoller.h"
+#include "logging.h"
 #include "channel.h"
-#include <iostream>
 #include <cassert>
 #include <unistd.h>
 #include <cstring>
+#include <algorithm>
 
 const int Epoller::kInitEventListSize;
+const size_t Epoller::kInitChannelTableSize;
+
+namespace {
+    // Channel::index()记录Channel在Epoller中的状态
+    const int kNew = -1;      // 不在表中
+    const int kAdded = 0;     // 在表中，已注册到epoll
+    const int kDeleted = 1;   // 在表中，没有关注的事件，已从epoll中删除
+}
 
 Epoller::Epoller()
     : epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
-      events_(kInitEventListSize) {
+      events_(kInitEventListSize),
+      channels_(kInitChannelTableSize, Entry()),
+      numChannels_(0) {
     if (epollfd_ < 0) {
-        std::cerr << "epoll_create1 error" << std::endl;
-        abort();
+        LOG_SYSFATAL << "epoll_create1 error";
     }
 }
 
@@ -38,7 +48,7 @@ int Epoller::poll(int timeoutMs, ChannelList* activeChannels) {
     } else {
         // 错误处理
         if (savedErrno != EINTR) {
-            std::cerr << "epoll_wait error" << std::endl;
+            LOG_SYSERR << "epoll_wait error";
         }
     }
     
@@ -49,61 +59,110 @@ void Epoller::updateChannel(Channel* channel) {
     int fd = channel->fd();
     int index = channel->index();
     
-    if (index == -1) {
-        // 新Channel，添加到epoll
-        // 检查是否已经存在该fd，如果存在则先删除它（处理fd重用的情况）
-        auto it = channels_.find(fd);
-        if (it != channels_.end()) {
-            // 确保旧的channel已经被正确删除
-            if (it->second != channel) {
-                // 先从epoll中删除旧的channel
-                update(EPOLL_CTL_DEL, it->second);
-                channels_.erase(it);
-            }
+    if (index == kNew) {
+        // 还没有关注任何事件（如关注后又在同一轮中取消），不必登记
+        if (channel->isNoneEvent()) {
+            return;
+        }
+        // 新Channel，登记到表中
+        if (static_cast<size_t>(fd) >= channels_.size()) {
+            channels_.resize(std::max(channels_.size() * 2, static_cast<size_t>(fd) + 1), Entry());
         }
-        
-        channels_[fd] = channel;
-        channel->set_index(0);
+        Channel* stale = channels_[fd].channel;
+        if (stale != nullptr && stale != channel) {
+            // fd被重用而旧的Channel没有移除：按fd从epoll中删除旧的注册，不再访问旧的Channel
+            LOG_WARN << "Epoller::updateChannel - replacing stale channel for fd: " << fd;
+            struct epoll_event event;
+            memset(&event, 0, sizeof event);
+            ::epoll_ctl(epollfd_, EPOLL_CTL_DEL, fd, &event);
+            --numChannels_;
+        }
+        channels_[fd].channel = channel;
+        ++numChannels_;
+        channel->set_index(kAdded);
         update(EPOLL_CTL_ADD, channel);
-    } else {
-        // 已存在的Channel，更新事件
-        auto it = channels_.find(fd);
-        if (it != channels_.end() && it->second == channel) {
-            if (channel->isNoneEvent()) {
-                // 如果没有关注的事件，从epoll中删除
-                update(EPOLL_CTL_DEL, channel);
-                channel->set_index(-1);
-            } else {
-                // 更新事件
-                update(EPOLL_CTL_MOD, channel);
-            }
-        } else {
-            // 如果channel不匹配，记录错误但不中断程序
-            std::cerr << "Warning: Channel mismatch or not found for fd: " << fd << std::endl;
+    } else if (findChannel(fd) != channel) {
+        // 如果channel不匹配，记录错误但不中断程序
+        LOG_WARN << "Warning: Channel mismatch or not found for fd: " << fd;
+        return;
+    } else if (index == kDeleted) {
+        // 已从epoll中删除的Channel重新关注事件
+        if (!channel->isNoneEvent()) {
+            channel->set_index(kAdded);
+            update(EPOLL_CTL_ADD, channel);
         }
+    } else if (channel->isNoneEvent()) {
+        // 如果没有关注的事件，从epoll中删除，保留表项
+        update(EPOLL_CTL_DEL, channel);
+        channel->set_index(kDeleted);
+    } else if (channel->events() == channels_[fd].events) {
+        // 关注的事件与已注册的相同（如一轮中先开启再关闭可写事件），不调用epoll_ctl
+    } else {
+        // 更新事件
+        update(EPOLL_CTL_MOD, channel);
     }
+#ifdef DEBUG
+    checkConsistency();
+#endif
 }
 
 void Epoller::removeChannel(Channel* channel) {
     int fd = channel->fd();
-    assert(channels_.find(fd) != channels_.end());
-    assert(channels_[fd] == channel);
+    int index = channel->index();
     assert(channel->isNoneEvent());
+
+    // 从未登记到表中（关注的事件还没有应用就被移除），没有需要清理的状态
+    if (index == kNew) {
+        return;
+    }
+    assert(findChannel(fd) == channel);
     
-    int index = channel->index();
-    size_t n = channels_.erase(fd);
-    assert(n == 1);
+    // 发布版本中assert不生效，表项不匹配时只记录错误，不动其他Channel的表项
+    if (findChannel(fd) != channel) {
+        LOG_ERROR << "Epoller::removeChannel - channel not registered for fd: " << fd;
+        channel->set_index(kNew);
+        return;
+    }
+    channels_[fd].channel = nullptr;
+    --numChannels_;
     
-    if (index == 1) {
+    // 仍注册在epoll中（调用方没有先禁用所有事件）时删除注册，避免留下悬空的Channel指针
+    if (index == kAdded) {
         update(EPOLL_CTL_DEL, channel);
     }
-    channel->set_index(-1);
+    channel->set_index(kNew);
+#ifdef DEBUG
+    checkConsistency();
+#endif
 }
 
 bool Epoller::hasChannel(Channel* channel) {
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    return findChannel(channel->fd()) == channel;
+}
+
+#ifdef DEBUG
+void Epoller::checkConsistency() const {
+    size_t count = 0;
+    for (size_t fd = 0; fd < channels_.size(); ++fd) {
+        const Channel* channel = channels_[fd].channel;
+        if (channel == nullptr) {
+            continue;
+        }
+        ++count;
+        // 已注册的事件只记录在表中：kAdded时非空，kDeleted时为空
+        bool registered = channels_[fd].events != 0;
+        if (static_cast<size_t>(channel->fd()) != fd ||
+            (channel->index() != kAdded && channel->index() != kDeleted) ||
+            registered != (channel->index() == kAdded)) {
+            LOG_FATAL << "Epoller::checkConsistency - bad entry for fd: " << fd;
+        }
+    }
+    if (count != numChannels_) {
+        LOG_FATAL << "Epoller::checkConsistency - table holds " << count
+                  << " channels, expected " << numChannels_;
+    }
 }
+#endif
 
 void Epoller::fillActiveChannels(int numEvents, ChannelList* activeChannels) const {
     assert(static_cast<size_t>(numEvents) <= events_.size());
@@ -122,13 +181,11 @@ void Epoller::update(int operation, Channel* channel) {
     int fd = channel->fd();
     
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0) {
-        std::cerr << "epoll_ctl error: operation=" << operation 
-                  << ", fd=" << fd << std::endl;
         if (operation == EPOLL_CTL_DEL) {
-            std::cerr << "epoll_ctl del error" << std::endl;
+            LOG_SYSERR << "epoll_ctl del error: fd=" << fd;
         } else {
-            std::cerr << "epoll_ctl add/mod error" << std::endl;
-            abort();
+            LOG_SYSFATAL << "epoll_ctl add/mod error: operation=" << operation << ", fd=" << fd;
         }
     }
+    channels_[fd].events = operation == EPOLL_CTL_DEL ? 0 : event.events;
 }
\ No newline at end of file
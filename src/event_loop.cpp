@@ -1,21 +1,25 @@
 #include "event_loop.h"
+#include "logging.h"
 #include "channel.h"
-#include "epoller.h"
-#include <iostream>
+#include "poller.h"
+#include "timer_queue.h"
 #include <cassert>
 #include <sys/eventfd.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <functional>
+#include <algorithm>
 
 namespace {
+    // 空闲时loopLatency()读到的滑动平均每隔这么久减半（微秒）
+    const int64_t kLatencyHalfLifeUs = 100 * 1000;
+
     // 创建eventfd用于唤醒线程
     int createEventfd() {
         int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
         if (evtfd < 0) {
-            std::cerr << "Failed in eventfd" << std::endl;
-            abort();
+            LOG_SYSFATAL << "Failed in eventfd";
         }
         return evtfd;
     }
@@ -29,16 +33,85 @@ namespace {
     };
 
     IgnoreSigPipe initObj;
+
+    // 任务对象不超过kTaskSlotSize字节时使用本线程缓存的内存，释放时放回释放线程的缓存，
+    // 每个线程最多缓存kMaxCachedTasks个；IO线程给自己排队的回调（如关闭连接、继续读写）不再经过malloc
+    const size_t kTaskSlotSize = 128;
+    const size_t kMaxCachedTasks = 256;
+
+    class TaskCache {
+    public:
+        TaskCache() : freeList_(nullptr), count_(0) {}
+        ~TaskCache() {
+            while (freeList_ != nullptr) {
+                FreeSlot* slot = freeList_;
+                freeList_ = slot->next;
+                ::operator delete(slot);
+            }
+        }
+
+        void* allocate() {
+            if (freeList_ == nullptr) {
+                return ::operator new(kTaskSlotSize);
+            }
+            FreeSlot* slot = freeList_;
+            freeList_ = slot->next;
+            --count_;
+            return slot;
+        }
+
+        void deallocate(void* p) {
+            if (count_ >= kMaxCachedTasks) {
+                ::operator delete(p);
+                return;
+            }
+            FreeSlot* slot = static_cast<FreeSlot*>(p);
+            slot->next = freeList_;
+            freeList_ = slot;
+            ++count_;
+        }
+
+    private:
+        struct FreeSlot {
+            FreeSlot* next;
+        };
+
+        FreeSlot* freeList_;
+        size_t count_;
+    };
+
+    thread_local TaskCache t_taskCache;
+}
+
+void* EventLoop::Task::operator new(size_t size) {
+    if (size <= kTaskSlotSize) {
+        return t_taskCache.allocate();
+    }
+    return ::operator new(size);
+}
+
+void EventLoop::Task::operator delete(void* p, size_t size) {
+    if (size <= kTaskSlotSize) {
+        t_taskCache.deallocate(p);
+    } else {
+        ::operator delete(p);
+    }
 }
 
 EventLoop::EventLoop()
     : looping_(false),
       quit_(false),
       callingPendingFunctors_(false),
+      wakeupPending_(false),
       threadId_(::pthread_self()),
       wakeupFd_(createEventfd()),
-      poller_(new Epoller()),
-      wakeupChannel_(new Channel(this, wakeupFd_)) {
+      poller_(Poller::newDefaultPoller()),
+      timerQueue_(new TimerQueue(this)),
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      activeConnections_(0),
+      pendingOutputBytes_(0),
+      loopLatency_(0),
+      loopLatencyTime_(0) {
     wakeupChannel_->setReadCallback(
         std::bind(&EventLoop::handleRead, this));
     wakeupChannel_->enableReading();
@@ -46,8 +119,14 @@ EventLoop::EventLoop()
 
 EventLoop::~EventLoop() {
     wakeupChannel_->disableAll();
-    // 使用disableAll()替代remove()，因为Channel类没有remove()方法
+    // 从Poller的表中移除，wakeupChannel_先于timerQueue_析构，不能留下悬空的表项
+    removeChannel(wakeupChannel_.get());
     ::close(wakeupFd_);
+
+    // 未执行的回调直接释放
+    while (Task* task = pendingFunctors_.pop()) {
+        delete task;
+    }
 }
 
 void EventLoop::loop() {
@@ -58,18 +137,51 @@ void EventLoop::loop() {
 
     while (!quit_) {
         activeChannels_.clear();
-        int numEvents = poller_->poll(-1, &activeChannels_);
+        applyChannelUpdates();
+        poller_->poll(-1, &activeChannels_);
+        Timestamp pollReturn(Timestamp::now());
         
         for (Channel* channel : activeChannels_) {
             channel->handleEvent();
         }
         
         doPendingFunctors();
+
+        // 本轮处理耗时按1/8的权重计入滑动平均
+        // 步长向远离0的方向取整：截断或四舍五入时差值小于8（或4）就不再变化
+        // 空闲期间没有采样，先按空闲时长衰减（与loopLatency()相同），再计入本轮
+        int64_t finish = Timestamp::now().microSecondsSinceEpoch();
+        int64_t elapsed = finish - pollReturn.microSecondsSinceEpoch();
+        int64_t latency = decayedLatency(loopLatency_.load(std::memory_order_relaxed),
+                                         pollReturn.microSecondsSinceEpoch() -
+                                         loopLatencyTime_.load(std::memory_order_relaxed));
+        int64_t delta = elapsed - latency;
+        latency += (delta + (delta > 0 ? 7 : (delta < 0 ? -7 : 0))) / 8;
+        loopLatency_.store(latency, std::memory_order_relaxed);
+        loopLatencyTime_.store(finish, std::memory_order_relaxed);
     }
 
     looping_ = false;
 }
 
+int64_t EventLoop::decayedLatency(int64_t latency, int64_t idleUs) {
+    int64_t halvings = idleUs / kLatencyHalfLifeUs;
+    if (halvings <= 0) {
+        return latency;
+    }
+    return halvings >= 63 ? 0 : latency >> halvings;
+}
+
+int64_t EventLoop::loopLatency() const {
+    // 空闲的线程阻塞在poll中不再采样，读取时按距上次采样的时长衰减，不必为此定期唤醒
+    int64_t latency = loopLatency_.load(std::memory_order_relaxed);
+    if (latency == 0) {
+        return 0;
+    }
+    return decayedLatency(latency, Timestamp::now().microSecondsSinceEpoch() -
+                                   loopLatencyTime_.load(std::memory_order_relaxed));
+}
+
 void EventLoop::quit() {
     quit_ = true;
     if (!isInLoopThread()) {
@@ -87,22 +199,15 @@ bool EventLoop::isInLoopThread() const {
     return ::pthread_equal(threadId_, ::pthread_self()) != 0;
 }
 
-void EventLoop::runInLoop(Functor cb) {
-    if (isInLoopThread()) {
-        cb();
-    } else {
-        queueInLoop(std::move(cb));
-    }
-}
-
-void EventLoop::queueInLoop(Functor cb) {
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        pendingFunctors_.push_back(std::move(cb));
-    }
+void EventLoop::queueTask(Task* task) {
+    pendingFunctors_.push(task);
     
+    // 只有清除标志后的第一个生产者写eventfd，之后的生产者搭便车
+    // 必须在push完成之后检查标志：消费者清除标志后一定能看到这里入队的回调
     if (!isInLoopThread() || callingPendingFunctors_) {
-        wakeup();
+        if (!wakeupPending_.exchange(true, std::memory_order_acq_rel)) {
+            wakeup();
+        }
     }
 }
 
@@ -110,69 +215,96 @@ void EventLoop::wakeup() {
     uint64_t one = 1;
     ssize_t n = ::write(wakeupFd_, &one, sizeof one);
     if (n != sizeof one) {
-        std::cerr << "EventLoop::wakeup() writes " << n << " bytes instead of 8" << std::endl;
+        LOG_ERROR << "EventLoop::wakeup() writes " << n << " bytes instead of 8";
     }
 }
 
 void EventLoop::updateChannel(Channel* channel) {
     assert(channel->ownerLoop() == this);
     assertInLoopThread();
-    poller_->updateChannel(channel);
+    channel->setDirtyIndex(static_cast<int>(dirtyChannels_.size()));
+    dirtyChannels_.push_back(channel);
 }
 
 void EventLoop::removeChannel(Channel* channel) {
     assert(channel->ownerLoop() == this);
     assertInLoopThread();
+    // Channel即将销毁，尚未应用的修改直接丢弃（按记录的下标置空，不搬移列表）；Poller按已注册的状态清理
+    if (channel->dirty()) {
+        assert(dirtyChannels_[channel->dirtyIndex()] == channel);
+        dirtyChannels_[channel->dirtyIndex()] = nullptr;
+        channel->setDirtyIndex(-1);
+    }
     poller_->removeChannel(channel);
 }
 
+void EventLoop::applyChannelUpdates() {
+    // 应用到Poller时不会再修改Channel，遍历过程中列表不变；已移除的Channel留下空位
+    for (Channel* channel : dirtyChannels_) {
+        if (channel != nullptr) {
+            channel->setDirtyIndex(-1);
+            poller_->updateChannel(channel);
+        }
+    }
+    dirtyChannels_.clear();
+}
+
 bool EventLoop::hasChannel(Channel* channel) {
     assert(channel->ownerLoop() == this);
     assertInLoopThread();
     return poller_->hasChannel(channel);
 }
 
+Poller* EventLoop::completionPoller() const {
+    return poller_->supportsCompletions() ? poller_.get() : nullptr;
+}
+
 void EventLoop::handleRead() {
     uint64_t one = 1;
     ssize_t n = ::read(wakeupFd_, &one, sizeof one);
     if (n != sizeof one) {
-        std::cerr << "EventLoop::handleRead() reads " << n << " bytes instead of 8" << std::endl;
+        LOG_ERROR << "EventLoop::handleRead() reads " << n << " bytes instead of 8";
     }
 }
 
 void EventLoop::doPendingFunctors() {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
+    // 先清除标志再取回调，之后入队的生产者会重新写eventfd
+    wakeupPending_.exchange(false, std::memory_order_acq_rel);
     
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);
+    // 先取出当前所有回调再执行，执行期间新入队的回调留到下一轮，不会饿死IO事件
+    while (Task* task = pendingFunctors_.pop()) {
+        runningFunctors_.push_back(task);
     }
     
-    for (const Functor& functor : functors) {
-        functor();
+    for (Task* task : runningFunctors_) {
+        task->run();
+        delete task;
     }
+    runningFunctors_.clear();
     
     callingPendingFunctors_ = false;
 }
 
-void EventLoop::runAfter(double delay, Functor cb) {
+TimerId EventLoop::runAt(Timestamp time, Functor cb) {
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, Functor cb) {
     Timestamp time(addTime(Timestamp::now(), delay));
-    // 这里暂时简化实现，实际应该使用定时器类
-    queueInLoop(std::move(cb));
+    return runAt(time, std::move(cb));
 }
 
-void EventLoop::runEvery(double interval, Functor cb) {
-    // 这里暂时简化实现，实际应该使用定时器类
-    auto task = [this, interval, cb]() {
-        cb();
-        runEvery(interval, cb);
-    };
-    runAfter(interval, task);
+TimerId EventLoop::runEvery(double interval, Functor cb) {
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId) {
+    timerQueue_->cancel(timerId);
 }
 
 void EventLoop::abortNotInLoopThread() {
-    std::cerr << "EventLoop::abortNotInLoopThread() - EventLoop was created in threadId_ = " 
-              << threadId_ << ", current thread id = " << ::pthread_self() << std::endl;
-    abort();
+    LOG_FATAL << "EventLoop::abortNotInLoopThread() - EventLoop was created in threadId_ = " 
+              << threadId_ << ", current thread id = " << ::pthread_self();
 }
\ No newline at end of file
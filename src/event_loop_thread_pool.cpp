@@ -1,15 +1,17 @@
 #include "event_loop_thread_pool.h"
+#include "thread_affinity.h"
 #include <iostream>
 #include <cassert>
 
-EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string& name)
+EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string& name, int cpu)
     : loop_(nullptr),
       exiting_(false),
       thread_(),  // 默认构造空线程对象
       mutex_(),
       cond_(),
       callback_(cb),
-      name_(name) {
+      name_(name),
+      cpu_(cpu) {
 }
 
 EventLoopThread::~EventLoopThread() {
@@ -38,6 +40,13 @@ EventLoop* EventLoopThread::startLoop() {
 }
 
 void EventLoopThread::threadFunc() {
+    if (!name_.empty()) {
+        setCurrentThreadName(name_);
+    }
+    // 先绑定CPU再创建EventLoop，EventLoop的内存在本地NUMA节点上首次分配
+    if (cpu_ >= 0) {
+        bindCurrentThreadToCpu(cpu_);
+    }
     EventLoop loop;
 
     if (callback_) {
@@ -61,7 +70,8 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const std::string&
       name_(nameArg),
       started_(false),
       numThreads_(0),
-      next_(0) {
+      next_(0),
+      policy_(DispatchPolicy::kRoundRobin) {
 }
 
 EventLoopThreadPool::~EventLoopThreadPool() {
@@ -77,7 +87,8 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
     for (int i = 0; i < numThreads_; ++i) {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
-        EventLoopThread* t = new EventLoopThread(cb, buf);
+        int cpu = cpus_.empty() ? -1 : cpus_[i % cpus_.size()];
+        EventLoopThread* t = new EventLoopThread(cb, buf, cpu);
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop());
     }
@@ -96,16 +107,45 @@ EventLoop* EventLoopThreadPool::getNextLoop() {
 
     if (!loops_.empty()) {
         // 轮询选择下一个EventLoop
-        loop = loops_[next_];
+        size_t index = static_cast<size_t>(next_);
         ++next_;
         if (static_cast<size_t>(next_) >= loops_.size()) {
             next_ = 0;
         }
+        if (policy_ != DispatchPolicy::kRoundRobin) {
+            // 从轮询位置开始找负载最小的线程，负载相同时仍按轮询分散
+            index = leastLoaded(index);
+        }
+        loop = loops_[index];
     }
     
     return loop;
 }
 
+size_t EventLoopThreadPool::leastLoaded(size_t start) const {
+    size_t best = start;
+    int64_t bestLoad = 0;
+    int bestConnections = 0;
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        size_t index = (start + i) % loops_.size();
+        const EventLoop* loop = loops_[index];
+        int64_t load = 0;
+        if (policy_ == DispatchPolicy::kLeastPendingBytes) {
+            load = loop->pendingOutputBytes();
+        } else if (policy_ == DispatchPolicy::kLeastLatency) {
+            load = loop->loopLatency();
+        }
+        // 连接数作为第二关键字（kLeastConnections时是唯一关键字）
+        int connections = loop->activeConnections();
+        if (i == 0 || load < bestLoad || (load == bestLoad && connections < bestConnections)) {
+            best = index;
+            bestLoad = load;
+            bestConnections = connections;
+        }
+    }
+    return best;
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops() {
     baseLoop_->assertInLoopThread();
     assert(started_);
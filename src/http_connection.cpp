@@ -1,286 +1,133 @@
 #include "http_connection.h"
+#include "logging.h"
 #include <cstring>
-#include <iostream>
-#include <sstream>
-#include <fcntl.h>
-#include <unistd.h>
+#include <strings.h>
 #include <vector>
 #include <string>
 #include "timestamp.h"
+#include "metrics.h"
+#include "utils.h"
 
 // 构造函数
-HttpConnection::HttpConnection(int sockfd)
-    : sockfd_(sockfd), isClose_(false), isProcessing_(false),
-      parseState_(HttpRequestParseState::REQUEST_LINE), method_(HttpMethod::UNKNOWN) {
-    addr_.sin_family = AF_INET;
-    addr_.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr_.sin_port = htons(0);
-    
-    // 设置非阻塞
-    int flags = fcntl(sockfd_, F_GETFL, 0);
-    fcntl(sockfd_, F_SETFL, flags | O_NONBLOCK);
+HttpConnection::HttpConnection()
+    : isProcessing_(false), isClose_(false),
+      maxRequests_(kDefaultMaxRequests), requestCount_(0), responseStatus_(0) {
 }
 
-// 析构函数
+// 析构函数（套接字由TcpConnection/Socket负责关闭）
 HttpConnection::~HttpConnection() {
-    ::close(sockfd_);
 }
 
 // 处理HTTP请求
-bool HttpConnection::process() {
+HttpRequest::ParseResult HttpConnection::process(Buffer* input) {
+    // 增量解析，从上次停下的位置继续
+    HttpRequest::ParseResult result = request_.parse(input);
+    if (result == HttpRequest::ParseResult::NEED_MORE) {
+        return result;
+    }
+    
     isProcessing_ = true;
+    ++requestCount_;
+    StringPiece method = request_.getMethodString();
+    StringPiece path = request_.getPath();
+    requestMethod_.assign(method.data(), method.size());
+    requestPath_.assign(path.data(), path.size());
     
     try {
-        // 解析请求
-        if (!parseRequest()) {
+        if (result == HttpRequest::ParseResult::ERROR) {
+            isClose_ = true;
             generateErrorResponse(400, "Bad Request");
+            // 连接即将关闭，剩余数据没有意义
+            input->retrieveAll();
             isProcessing_ = false;
-            return false;
+            return result;
         }
         
+        // 根据请求决定是否保持连接
+        updateKeepAlive();
+        
         // 生成响应
         generateResponse();
         
+        // 响应已生成，请求数据不再被引用，只消费本请求的字节，流水线中的后续请求保留
+        input->retrieve(request_.requestLength());
         isProcessing_ = false;
-        return true;
+        return result;
     } catch (const std::exception& e) {
-        std::cerr << "HttpConnection::process exception: " << e.what() << std::endl;
+        LOG_ERROR << "HttpConnection::process exception: " << e.what();
+        isClose_ = true;
         generateErrorResponse(500, "Internal Server Error");
+        input->retrieveAll();
         isProcessing_ = false;
-        return false;
+        return HttpRequest::ParseResult::ERROR;
     } catch (...) {
-        std::cerr << "HttpConnection::process unknown exception" << std::endl;
+        LOG_ERROR << "HttpConnection::process unknown exception";
+        isClose_ = true;
         generateErrorResponse(500, "Internal Server Error");
+        input->retrieveAll();
         isProcessing_ = false;
-        return false;
-    }
-}
-
-// 解析HTTP请求
-bool HttpConnection::parseRequest() {
-    std::istringstream requestStream(readBuffer_);
-    std::string line;
-    
-    // 解析请求行
-    if (parseState_ == HttpRequestParseState::REQUEST_LINE) {
-        if (!std::getline(requestStream, line)) {
-            return false;
-        }
-        // 去除行尾的
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-        if (!parseRequestLine(line)) {
-            return false;
-        }
-        parseState_ = HttpRequestParseState::HEADERS;
-    }
-    
-    // 解析请求头
-    if (parseState_ == HttpRequestParseState::HEADERS) {
-        while (std::getline(requestStream, line)) {
-            // 去除行尾的
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
-            }
-            // 遇到空行表示请求头结束
-            if (line.empty()) {
-                parseState_ = HttpRequestParseState::BODY;
-                break;
-            }
-            if (!parseHeaders(line)) {
-                return false;
-            }
-        }
+        return HttpRequest::ParseResult::ERROR;
     }
-    
-    // 解析请求体
-    if (parseState_ == HttpRequestParseState::BODY) {
-        // 读取剩余的所有数据作为请求体
-        std::string restOfData;
-        std::string tempLine;
-        while (std::getline(requestStream, tempLine)) {
-            if (!tempLine.empty() && tempLine.back() == '\r') {
-                tempLine.pop_back();
-            }
-            restOfData += tempLine + '\n';
-        }
-        if (!restOfData.empty()) {
-            restOfData.pop_back(); // 移除最后一个换行符
-            if (!parseBody(restOfData)) {
-                return false;
-            }
-        }
-        parseState_ = HttpRequestParseState::FINISH;
-    }
-    
-    return parseState_ == HttpRequestParseState::FINISH;
 }
 
-// 解析请求行
-bool HttpConnection::parseRequestLine(const std::string &line) {
-    std::istringstream lineStream(line);
-    std::string methodStr, fullPath;
+// 根据HTTP版本和Connection头决定响应后是否关闭连接
+void HttpConnection::updateKeepAlive() {
+    StringPiece connection = request_.getHeader("Connection");
+    StringPiece version = request_.getVersion();
     
-    if (!(lineStream >> methodStr >> fullPath >> version_)) {
-        return false;
-    }
-    
-    // 解析请求方法
-    if (methodStr == "GET") {
-        method_ = HttpMethod::GET;
-    } else if (methodStr == "POST") {
-        method_ = HttpMethod::POST;
-    } else if (methodStr == "HEAD") {
-        method_ = HttpMethod::HEAD;
-    } else if (methodStr == "PUT") {
-        method_ = HttpMethod::PUT;
-    } else if (methodStr == "DELETE") {
-        method_ = HttpMethod::DELETE;
+    if (version == "HTTP/1.1") {
+        // HTTP/1.1默认保持连接
+        isClose_ = connection.equalsIgnoreCase("close");
+    } else if (version == "HTTP/1.0") {
+        // HTTP/1.0默认关闭连接
+        isClose_ = !connection.equalsIgnoreCase("keep-alive");
     } else {
-        method_ = HttpMethod::UNKNOWN;
+        isClose_ = true;
     }
     
-    // 解析路径和查询参数
-    size_t queryPos = fullPath.find('?');
-    if (queryPos != std::string::npos) {
-        path_ = fullPath.substr(0, queryPos);
-        std::string queryStr = fullPath.substr(queryPos + 1);
-        
-        // 解析查询参数
-        size_t start = 0;
-        size_t end = 0;
-        while ((end = queryStr.find('&', start)) != std::string::npos) {
-            std::string param = queryStr.substr(start, end - start);
-            size_t eqPos = param.find('=');
-            if (eqPos != std::string::npos) {
-                std::string key = param.substr(0, eqPos);
-                std::string value = param.substr(eqPos + 1);
-                queryParams_[key] = value;
-            }
-            start = end + 1;
-        }
-        // 处理最后一个参数
-        std::string param = queryStr.substr(start);
-        size_t eqPos = param.find('=');
-        if (eqPos != std::string::npos) {
-            std::string key = param.substr(0, eqPos);
-            std::string value = param.substr(eqPos + 1);
-            queryParams_[key] = value;
-        }
-    } else {
-        path_ = fullPath;
+    // 达到单连接最大请求数后关闭连接
+    if (maxRequests_ > 0 && requestCount_ >= maxRequests_) {
+        isClose_ = true;
     }
-    
-    return true;
 }
 
-// 解析请求头
-bool HttpConnection::parseHeaders(const std::string &line) {
-    size_t colonPos = line.find(':');
-    if (colonPos == std::string::npos) {
-        return false;
-    }
-    
-    std::string key = line.substr(0, colonPos);
-    std::string value = line.substr(colonPos + 1);
-    
-    // 去除value前后的空格
-    value.erase(0, value.find_first_not_of(" \t"));
-    value.erase(value.find_last_not_of(" \t") + 1);
-    
-    headers_[key] = value;
-    
-    return true;
-}
-
-// 解析请求体
-bool HttpConnection::parseBody(const std::string &body) {
-    body_ = body;
-    return true;
-}
-
-// 获取MIME类型
-bool HttpConnection::getFileExtension(const std::string& path, std::string& extension) {
-    size_t dotPos = path.find_last_of('.');
-    if (dotPos == std::string::npos || dotPos == path.size() - 1) {
-        return false;
-    }
-    extension = path.substr(dotPos + 1);
-    return true;
-}
-
-// 获取MIME类型
-std::string HttpConnection::getMimeType(const std::string& extension) {
-    if (extension == "html" || extension == "htm") return "text/html; charset=utf-8";
-    if (extension == "css") return "text/css; charset=utf-8";
-    if (extension == "js") return "application/javascript; charset=utf-8";
-    if (extension == "json") return "application/json; charset=utf-8";
-    if (extension == "png") return "image/png";
-    if (extension == "jpg" || extension == "jpeg") return "image/jpeg";
-    if (extension == "gif") return "image/gif";
-    if (extension == "svg") return "image/svg+xml";
-    if (extension == "pdf") return "application/pdf";
-    if (extension == "txt") return "text/plain; charset=utf-8";
-    if (extension == "xml") return "application/xml";
-    if (extension == "zip") return "application/zip";
-    if (extension == "mp3") return "audio/mpeg";
-    if (extension == "mp4") return "video/mp4";
-    // 默认MIME类型
-    return "application/octet-stream";
-}
-
-// 读取文件内容
-bool HttpConnection::readFile(const std::string& filePath, std::string& content) {
-    FILE* file = fopen(filePath.c_str(), "rb");
-    if (!file) {
-        return false;
-    }
-    
-    // 获取文件大小
-    fseek(file, 0, SEEK_END);
-    long fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    // 读取文件内容
-    content.resize(fileSize);
-    size_t bytesRead = fread(&content[0], 1, fileSize, file);
-    fclose(file);
-    
-    return bytesRead == fileSize;
+// 响应中的Connection头
+const char* HttpConnection::connectionHeader() const {
+    return isClose_ ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
 }
 
 // 处理静态文件请求
 bool HttpConnection::handleStaticFile() {
     // 文件路径映射 - 将URI映射到服务器本地文件系统路径
-    std::string filePath = "/home/WebFileServer/public";
+    // 规范化后的路径同时作为缓存的键，"/a/../b"与"/b"命中同一项，也不会跳出根目录
+    std::string path = normalizePath(request_.getPath().toString());
+    std::string filePath = "/home/WebFileServer/public/";
+    filePath += path.empty() ? "index.html" : path;
     
-    if (path_ == "/") {
-        filePath += "/index.html";
-    } else {
-        filePath += path_;
-    }
-    
-    // 检查文件是否存在并可读
-    std::string fileContent;
-    if (!readFile(filePath, fileContent)) {
+    // 打开文件缓存：有效期内不再open/fstat，不存在的路径也会被缓存
+    OpenFileCache::FilePtr file = OpenFileCache::instance().open(filePath);
+    if (!file->isRegular()) {
         return false;
     }
     
-    // 获取文件扩展名和MIME类型
-    std::string extension;
-    std::string mimeType = "application/octet-stream";
-    if (getFileExtension(filePath, extension)) {
-        mimeType = getMimeType(extension);
+    // 常用的小文件直接从共享缓存返回，Content-Type和Content-Length已预先生成
+    StaticFileCache::EntryPtr entry = StaticFileCache::instance().get(filePath, file);
+    if (entry) {
+        responseHeader_ = "HTTP/1.1 200 OK\r\n";
+        responseHeader_ += entry->headerFields();
+        responseHeader_ += connectionHeader();
+        responseHeader_ += "\r\n";
+        responseContent_.swap(entry);
+        return true;
     }
     
-    // 生成响应
+    // 不可缓存的大文件，响应体稍后通过sendfile直接从页缓存发送，不读入内存
     responseHeader_ = "HTTP/1.1 200 OK\r\n";
-    responseHeader_ += "Content-Type: " + mimeType + "\r\n";
-    responseHeader_ += "Content-Length: " + std::to_string(fileContent.size()) + "\r\n";
-    responseHeader_ += "Connection: keep-alive\r\n";
+    responseHeader_ += "Content-Type: " + StaticFileCache::mimeType(filePath) + "\r\n";
+    responseHeader_ += "Content-Length: " + std::to_string(file->size()) + "\r\n";
+    responseHeader_ += connectionHeader();
     responseHeader_ += "\r\n";
-    responseHeader_ += fileContent;
+    responseFile_.swap(file);
     
     return true;
 }
@@ -288,31 +135,13 @@ bool HttpConnection::handleStaticFile() {
 // 处理API请求
 bool HttpConnection::handleApiRequest() {
     // 处理表单提交
-    if (path_ == "/api/submit" && method_ == HttpMethod::POST) {
+    StringPiece path = request_.getPath();
+    if (path == "/api/submit" && request_.getMethod() == HttpRequest::HttpMethod::POST) {
         // 解析表单数据
         std::unordered_map<std::string, std::string> formData;
         
         // 假设表单数据是x-www-form-urlencoded格式
-        size_t start = 0;
-        size_t end = 0;
-        while ((end = body_.find('&', start)) != std::string::npos) {
-            std::string param = body_.substr(start, end - start);
-            size_t eqPos = param.find('=');
-            if (eqPos != std::string::npos) {
-                std::string key = param.substr(0, eqPos);
-                std::string value = param.substr(eqPos + 1);
-                formData[key] = value;
-            }
-            start = end + 1;
-        }
-        // 处理最后一个参数
-        std::string param = body_.substr(start);
-        size_t eqPos = param.find('=');
-        if (eqPos != std::string::npos) {
-            std::string key = param.substr(0, eqPos);
-            std::string value = param.substr(eqPos + 1);
-            formData[key] = value;
-        }
+        HttpRequest::parseUrlEncoded(request_.getBody(), &formData);
         
         // 生成JSON响应
         std::string jsonResponse = "{";
@@ -332,19 +161,34 @@ bool HttpConnection::handleApiRequest() {
         responseHeader_ = "HTTP/1.1 200 OK\r\n";
         responseHeader_ += "Content-Type: application/json; charset=utf-8\r\n";
         responseHeader_ += "Content-Length: " + std::to_string(jsonResponse.size()) + "\r\n";
-        responseHeader_ += "Connection: keep-alive\r\n";
+        responseHeader_ += connectionHeader();
         responseHeader_ += "\r\n";
-        responseHeader_ += jsonResponse;
+        responseBody_.swap(jsonResponse);
         
         return true;
     }
     
+    // 运行指标，Prometheus文本格式
+    else if (path == "/api/metrics") {
+        std::string metrics;
+        Metrics::instance().writePrometheus(&metrics);
+
+        responseHeader_ = "HTTP/1.1 200 OK\r\n";
+        responseHeader_ += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+        responseHeader_ += "Content-Length: " + std::to_string(metrics.size()) + "\r\n";
+        responseHeader_ += connectionHeader();
+        responseHeader_ += "\r\n";
+        responseBody_.swap(metrics);
+
+        return true;
+    }
+    
     // 处理其他API请求
-    else if (path_.substr(0, 5) == "/api/") {
+    else if (path.startsWith("/api/")) {
         std::string jsonResponse;
         
         // 特定处理/api/test端点
-        if (path_ == "/api/test") {
+        if (path == "/api/test") {
             jsonResponse = "{";
             jsonResponse += "\"status\": \"success\",";
             jsonResponse += "\"message\": \"API测试成功\",";
@@ -361,16 +205,17 @@ bool HttpConnection::handleApiRequest() {
             jsonResponse += "\"message\": \"WebFileServer API\",";
             jsonResponse += "\"available_endpoints\": [";
             jsonResponse += "{\"path\": \"/api/submit\", \"method\": \"POST\", \"description\": \"处理表单提交\"},";
-            jsonResponse += "{\"path\": \"/api/test\", \"method\": \"GET\", \"description\": \"API测试端点\"}]";
+            jsonResponse += "{\"path\": \"/api/test\", \"method\": \"GET\", \"description\": \"API测试端点\"},";
+            jsonResponse += "{\"path\": \"/api/metrics\", \"method\": \"GET\", \"description\": \"运行指标（Prometheus格式）\"}]";
             jsonResponse += "}";
         }
         
         responseHeader_ = "HTTP/1.1 200 OK\r\n";
         responseHeader_ += "Content-Type: application/json; charset=utf-8\r\n";
         responseHeader_ += "Content-Length: " + std::to_string(jsonResponse.size()) + "\r\n";
-        responseHeader_ += "Connection: keep-alive\r\n";
+        responseHeader_ += connectionHeader();
         responseHeader_ += "\r\n";
-        responseHeader_ += jsonResponse;
+        responseBody_.swap(jsonResponse);
         
         return true;
     }
@@ -380,8 +225,13 @@ bool HttpConnection::handleApiRequest() {
 
 // 生成HTTP响应
 void HttpConnection::generateResponse() {
-    // 清空响应头
+    // 清空响应
     responseHeader_.clear();
+    responseBody_.clear();
+    responseTrailer_.clear();
+    responseContent_.reset();
+    responseFile_.reset();
+    responseStatus_ = 200;
     
     // 首先尝试处理API请求
     if (handleApiRequest()) {
@@ -403,73 +253,47 @@ void HttpConnection::generateErrorResponse(int statusCode, const std::string &me
     html += "<h1>" + std::to_string(statusCode) + " " + message + "</h1>";
     html += "</body></html>";
     
+    responseStatus_ = statusCode;
     responseHeader_ = "HTTP/1.1 " + std::to_string(statusCode) + " " + message + "\r\n";
     responseHeader_ += "Content-Type: text/html; charset=utf-8\r\n";
     responseHeader_ += "Content-Length: " + std::to_string(html.size()) + "\r\n";
-    responseHeader_ += "Connection: close\r\n";
+    responseHeader_ += connectionHeader();
     responseHeader_ += "\r\n";
-    responseHeader_ += html;
+    responseBody_.swap(html);
 }
 
-// 重置连接状态
-void HttpConnection::reset() {
-    readBuffer_.clear();
+// 转移响应数据段的所有权
+void HttpConnection::takeResponse(std::string* header, std::string* body, std::string* trailer) {
+    header->swap(responseHeader_);
+    body->swap(responseBody_);
+    trailer->swap(responseTrailer_);
     responseHeader_.clear();
-    body_.clear();
-    parseState_ = HttpRequestParseState::REQUEST_LINE;
-    method_ = HttpMethod::UNKNOWN;
-    path_.clear();
-    version_.clear();
-    headers_.clear();
-    queryParams_.clear();
-    isProcessing_ = false;
-    isClose_ = false;
+    responseBody_.clear();
+    responseTrailer_.clear();
 }
 
-// 读取数据
-ssize_t HttpConnection::read(int* savedErrno) {
-    ssize_t len = 0;
-    ssize_t totalRead = 0;
-    char buffer[4096];
-    
-    while (true) {
-        len = ::read(sockfd_, buffer, sizeof(buffer));
-        if (len < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                break; // 非阻塞IO，没有更多数据可读
-            }
-            *savedErrno = errno;
-            return -1;
-        } else if (len == 0) {
-            break; // 对方关闭连接
-        }
-        totalRead += len;
-        readBuffer_.append(buffer, len);
-    }
-    return totalRead;
+// 转移响应缓存内容的所有权
+StaticFileCache::EntryPtr HttpConnection::takeResponseContent() {
+    StaticFileCache::EntryPtr entry;
+    entry.swap(responseContent_);
+    return entry;
 }
 
-// 关闭连接
-void HttpConnection::close() {
-    isClose_ = true;
+// 转移响应文件的所有权
+OpenFileCache::FilePtr HttpConnection::takeResponseFile() {
+    OpenFileCache::FilePtr file;
+    file.swap(responseFile_);
+    return file;
 }
 
-// 写入数据
-ssize_t HttpConnection::write(int* savedErrno) {
-    ssize_t len = 0;
-    
-    // 普通响应
-    if (!responseHeader_.empty()) {
-        len = ::write(sockfd_, responseHeader_.data(), responseHeader_.size());
-        if (len < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // 非阻塞IO，暂时无法写入
-                return len;
-            }
-            *savedErrno = errno;
-            return -1;
-        }
-    }
-    
-    return len;
-}
\ No newline at end of file
+// 重置请求状态，为同一连接上的下一个请求做准备（保留请求计数）
+void HttpConnection::reset() {
+    request_.reset();
+    responseHeader_.clear();
+    responseBody_.clear();
+    responseTrailer_.clear();
+    responseContent_.reset();
+    responseFile_.reset();
+    isProcessing_ = false;
+    isClose_ = false;
+}
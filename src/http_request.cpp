@@ -1,180 +1,250 @@
-#include "http_request.h"
-#include <algorithm>
-#include <iostream>
-
-HttpRequest::HttpRequest() 
-    : method_(HttpMethod::UNKNOWN),
-      path_(""),
-      version_(""),
-      body_(""),
-      state_(HttpRequestParseState::REQUEST_LINE),
-      readBuffer_("") {
-}
-
-void HttpRequest::reset() {
-    method_ = HttpMethod::UNKNOWN;
-    path_ = "";
-    version_ = "";
-    body_ = "";
-    state_ = HttpRequestParseState::REQUEST_LINE;
-    queryParams_.clear();
-    headers_.clear();
-    post_.clear();
-    readBuffer_.clear();
-}
-
-bool HttpRequest::parse(const std::shared_ptr<Buffer>& buffer) {
-    if (buffer->readableBytes() <= 0) {
-        return false;
-    }
-
-    // 将Buffer中的数据读取到readBuffer_
-    readBuffer_.append(buffer->peek(), buffer->readableBytes());
-    buffer->retrieveAll();
-
-    const char* CRLF = Buffer::kCRLF;
-    size_t hasRead = 0;
-    size_t dataSize = readBuffer_.size();
-
-    while (state_ != HttpRequestParseState::FINISH && hasRead < dataSize) {
-        const char* lineEnd = std::search(
-            readBuffer_.data() + hasRead,
-            readBuffer_.data() + dataSize,
-            CRLF,
-            CRLF + 2
-        );
-
-        if (lineEnd == readBuffer_.data() + dataSize) {
-            // 没有找到完整的行，退出循环
-            break;
-        }
-
-        std::string line(readBuffer_.data() + hasRead, lineEnd);
-        hasRead = static_cast<size_t>(lineEnd - readBuffer_.data()) + 2;
-
-        switch (state_) {
-            case HttpRequestParseState::REQUEST_LINE:
-                if (!parseRequestLine(line)) {
-                    return false;
-                }
-                break;
-            case HttpRequestParseState::HEADERS:
-                if (line.empty()) {
-                    // 头部解析完成，检查是否有请求体
-                    state_ = HttpRequestParseState::BODY;
-                } else {
-                    parseHeaders(line);
-                }
-                break;
-            case HttpRequestParseState::BODY:
-                parseBody(line);
-                state_ = HttpRequestParseState::FINISH;
-                break;
-            default:
-                break;
-        }
-    }
-
-    // 处理请求体（如果有的话）
-    if (state_ == HttpRequestParseState::BODY && hasRead < dataSize) {
-        std::string body(readBuffer_.data() + hasRead, readBuffer_.data() + dataSize);
-        parseBody(body);
-        state_ = HttpRequestParseState::FINISH;
-    }
-
-    return state_ == HttpRequestParseState::FINISH;
-}
-
-bool HttpRequest::parseRequestLine(const std::string& line) {
-    std::regex pattern("(GET|POST|PUT|DELETE)\\s+([^\\s]+)\\s+(HTTP/\\d\\.\\d)");
-    std::smatch result;
-
-    if (std::regex_match(line, result, pattern)) {
-        std::string methodStr = result[1].str();
-        if (methodStr == "GET") {
-            method_ = HttpMethod::GET;
-        } else if (methodStr == "POST") {
-            method_ = HttpMethod::POST;
-        } else if (methodStr == "PUT") {
-            method_ = HttpMethod::PUT;
-        } else if (methodStr == "DELETE") {
-            method_ = HttpMethod::DELETE;
-        }
-
-        std::string fullPath = result[2].str();
-        parsePath(fullPath);
-        version_ = result[3].str();
-        state_ = HttpRequestParseState::HEADERS;
-        return true;
-    }
-
-    return false;
-}
-
-bool HttpRequest::parseHeaders(const std::string& line) {
-    std::regex pattern("([^:]+):\\s*(.+)");
-    std::smatch result;
-
-    if (std::regex_match(line, result, pattern)) {
-        std::string key = result[1].str();
-        std::string value = result[2].str();
-        headers_[key] = value;
-        return true;
-    }
-
-    return false;
-}
-
-bool HttpRequest::parseBody(const std::string& body) {
-    body_ = body;
-
-    // 解析POST请求数据
-    if (method_ == HttpMethod::POST) {
-        auto it = headers_.find("Content-Type");
-        if (it != headers_.end() && it->second.find("application/x-www-form-urlencoded") != std::string::npos) {
-            // 解析表单数据
-            size_t pos = 0;
-            while (pos < body_.size()) {
-                size_t ampPos = body_.find('&', pos);
-                if (ampPos == std::string::npos) {
-                    ampPos = body_.size();
-                }
-                size_t eqPos = body_.find('=', pos);
-                if (eqPos != std::string::npos && eqPos < ampPos) {
-                    std::string key = body_.substr(pos, eqPos - pos);
-                    std::string value = body_.substr(eqPos + 1, ampPos - eqPos - 1);
-                    post_[key] = value;
-                }
-                pos = ampPos + 1;
-            }
-        }
-    }
-
-    return true;
-}
-
-void HttpRequest::parsePath(const std::string& fullPath) {
-    size_t queryPos = fullPath.find('?');
-    if (queryPos != std::string::npos) {
-        // 提取路径
-        path_ = fullPath.substr(0, queryPos);
-        // 解析查询参数
-        std::string query = fullPath.substr(queryPos + 1);
-        size_t pos = 0;
-        while (pos < query.size()) {
-            size_t ampPos = query.find('&', pos);
-            if (ampPos == std::string::npos) {
-                ampPos = query.size();
-            }
-            size_t eqPos = query.find('=', pos);
-            if (eqPos != std::string::npos && eqPos < ampPos) {
-                std::string key = query.substr(pos, eqPos - pos);
-                std::string value = query.substr(eqPos + 1, ampPos - eqPos - 1);
-                queryParams_[key] = value;
-            }
-            pos = ampPos + 1;
-        }
-    } else {
-        path_ = fullPath;
-    }
-}
\ No newline at end of file
+#include "http_request.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const HttpRequest::HttpMethod kMethods[] = {
+        HttpRequest::HttpMethod::GET,
+        HttpRequest::HttpMethod::POST,
+        HttpRequest::HttpMethod::HEAD,
+        HttpRequest::HttpMethod::PUT,
+        HttpRequest::HttpMethod::DELETE,
+        HttpRequest::HttpMethod::OPTIONS,
+        HttpRequest::HttpMethod::TRACE,
+        HttpRequest::HttpMethod::CONNECT
+    };
+    const char* const kMethodNames[] = {
+        "GET", "POST", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE", "CONNECT"
+    };
+
+    bool isOws(char c) {
+        return c == ' ' || c == '\t';
+    }
+}
+
+const size_t HttpRequest::kMaxHeaderSize;
+const size_t HttpRequest::kMaxBodySize;
+
+HttpRequest::HttpRequest()
+    : method_(HttpMethod::UNKNOWN),
+      state_(HttpRequestParseState::REQUEST_LINE),
+      base_(nullptr),
+      parsedBytes_(0),
+      scannedBytes_(0),
+      contentLength_(0),
+      hasContentLength_(false),
+      hasTransferEncoding_(false),
+      started_(false),
+      methodSlice_(),
+      pathSlice_(),
+      querySlice_(),
+      versionSlice_(),
+      bodySlice_() {
+}
+
+void HttpRequest::reset() {
+    method_ = HttpMethod::UNKNOWN;
+    state_ = HttpRequestParseState::REQUEST_LINE;
+    base_ = nullptr;
+    parsedBytes_ = 0;
+    scannedBytes_ = 0;
+    contentLength_ = 0;
+    hasContentLength_ = false;
+    hasTransferEncoding_ = false;
+    started_ = false;
+    methodSlice_ = Slice();
+    pathSlice_ = Slice();
+    querySlice_ = Slice();
+    versionSlice_ = Slice();
+    bodySlice_ = Slice();
+    // clear()保留容量，下一个请求不需要重新分配
+    headers_.clear();
+}
+
+HttpRequest::ParseResult HttpRequest::parse(const Buffer* buffer) {
+    base_ = buffer->peek();
+    const char* end = buffer->beginWrite();
+    const size_t readable = buffer->readableBytes();
+    if (readable > 0) {
+        started_ = true;
+    }
+
+    while (state_ != HttpRequestParseState::FINISH) {
+        if (state_ == HttpRequestParseState::BODY) {
+            // 等待请求体全部到达
+            if (readable - parsedBytes_ < contentLength_) {
+                return ParseResult::NEED_MORE;
+            }
+            bodySlice_.offset = parsedBytes_;
+            bodySlice_.length = contentLength_;
+            parsedBytes_ += contentLength_;
+            state_ = HttpRequestParseState::FINISH;
+            break;
+        }
+
+        // 从上次扫描停下的位置继续查找行尾，已扫描过的字节不再重复扫描
+        const char* lineBegin = base_ + parsedBytes_;
+        const char* scanFrom = base_ + scannedBytes_;
+        const char* lf = static_cast<const char*>(
+            memchr(scanFrom, '\n', static_cast<size_t>(end - scanFrom)));
+        if (lf == nullptr) {
+            scannedBytes_ = readable;
+            return readable > kMaxHeaderSize ? ParseResult::ERROR : ParseResult::NEED_MORE;
+        }
+
+        const char* lineEnd = lf;
+        if (lineEnd > lineBegin && *(lineEnd - 1) == '\r') {
+            --lineEnd;
+        }
+        parsedBytes_ = static_cast<size_t>(lf + 1 - base_);
+        scannedBytes_ = parsedBytes_;
+        if (parsedBytes_ > kMaxHeaderSize) {
+            return ParseResult::ERROR;
+        }
+
+        if (state_ == HttpRequestParseState::REQUEST_LINE) {
+            // 忽略请求之间多余的空行
+            if (lineBegin == lineEnd) {
+                continue;
+            }
+            if (!parseRequestLine(lineBegin, lineEnd)) {
+                return ParseResult::ERROR;
+            }
+            state_ = HttpRequestParseState::HEADERS;
+        } else if (lineBegin == lineEnd) {
+            // 空行表示请求头结束
+            if (contentLength_ > kMaxBodySize) {
+                return ParseResult::ERROR;
+            }
+            state_ = contentLength_ > 0 ? HttpRequestParseState::BODY
+                                        : HttpRequestParseState::FINISH;
+        } else if (!parseHeader(lineBegin, lineEnd)) {
+            return ParseResult::ERROR;
+        }
+    }
+
+    return ParseResult::COMPLETE;
+}
+
+bool HttpRequest::parseRequestLine(const char* begin, const char* end) {
+    // 方法
+    const char* space = std::find(begin, end, ' ');
+    if (space == begin || space == end) {
+        return false;
+    }
+    methodSlice_ = makeSlice(begin, space);
+    method_ = HttpMethod::UNKNOWN;
+    StringPiece method(begin, static_cast<size_t>(space - begin));
+    for (size_t i = 0; i < sizeof(kMethods) / sizeof(kMethods[0]); ++i) {
+        if (method == kMethodNames[i]) {
+            method_ = kMethods[i];
+            break;
+        }
+    }
+
+    // 请求目标（路径和查询串）
+    const char* target = space + 1;
+    space = std::find(target, end, ' ');
+    if (space == target || space == end) {
+        return false;
+    }
+    const char* question = std::find(target, space, '?');
+    pathSlice_ = makeSlice(target, question);
+    if (question != space) {
+        querySlice_ = makeSlice(question + 1, space);
+    }
+
+    // HTTP版本
+    const char* version = space + 1;
+    if (!StringPiece(version, static_cast<size_t>(end - version)).startsWith("HTTP/")) {
+        return false;
+    }
+    versionSlice_ = makeSlice(version, end);
+    return true;
+}
+
+bool HttpRequest::parseHeader(const char* begin, const char* end) {
+    const char* colon = std::find(begin, end, ':');
+    if (colon == begin || colon == end || isOws(*(colon - 1))) {
+        return false;
+    }
+
+    // 去除value前后的空白
+    const char* valueBegin = colon + 1;
+    while (valueBegin < end && isOws(*valueBegin)) {
+        ++valueBegin;
+    }
+    const char* valueEnd = end;
+    while (valueEnd > valueBegin && isOws(*(valueEnd - 1))) {
+        --valueEnd;
+    }
+
+    Header header = { makeSlice(begin, colon), makeSlice(valueBegin, valueEnd) };
+    headers_.push_back(header);
+
+    // 解析过程中需要用到的头部直接在这里处理
+    StringPiece name(begin, static_cast<size_t>(colon - begin));
+    if (name.equalsIgnoreCase("Content-Length")) {
+        if (valueBegin == valueEnd) {
+            return false;
+        }
+        size_t length = 0;
+        for (const char* p = valueBegin; p < valueEnd; ++p) {
+            if (*p < '0' || *p > '9' || length > kMaxBodySize) {
+                return false;
+            }
+            length = length * 10 + static_cast<size_t>(*p - '0');
+        }
+        // 重复的Content-Length必须一致；与Transfer-Encoding同时出现时请求边界有歧义（请求走私），一律拒绝
+        if ((hasContentLength_ && length != contentLength_) || hasTransferEncoding_) {
+            return false;
+        }
+        hasContentLength_ = true;
+        contentLength_ = length;
+    } else if (name.equalsIgnoreCase("Transfer-Encoding")) {
+        if (hasContentLength_) {
+            return false;
+        }
+        hasTransferEncoding_ = true;
+        // 暂不支持分块编码的请求体
+        return StringPiece(valueBegin, static_cast<size_t>(valueEnd - valueBegin))
+            .equalsIgnoreCase("identity");
+    }
+    return true;
+}
+
+StringPiece HttpRequest::getHeader(const StringPiece& name) const {
+    for (const Header& header : headers_) {
+        StringPiece key = piece(header.name);
+        if (key.equalsIgnoreCase(name)) {
+            return piece(header.value);
+        }
+    }
+    return StringPiece();
+}
+
+bool HttpRequest::hasHeader(const StringPiece& name) const {
+    for (const Header& header : headers_) {
+        if (piece(header.name).equalsIgnoreCase(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void HttpRequest::parseUrlEncoded(const StringPiece& data,
+                                  std::unordered_map<std::string, std::string>* params) {
+    const char* pos = data.begin();
+    const char* end = data.end();
+    while (pos < end) {
+        const char* amp = std::find(pos, end, '&');
+        const char* eq = std::find(pos, amp, '=');
+        if (eq != amp) {
+            (*params)[std::string(pos, eq)] = std::string(eq + 1, amp);
+        }
+        if (amp == end) {
+            break;
+        }
+        pos = amp + 1;
+    }
+}
@@ -1,7 +1,9 @@
 #include "inet_address.h"
+#include "logging.h"
 #include <cstring>
+#include <cstdio>
+#include <algorithm>
 #include <arpa/inet.h>
-#include <iostream>
 #include <cassert>
 
 static const in_addr_t kInaddrAny = INADDR_ANY;
@@ -31,14 +33,14 @@ InetAddress::InetAddress(std::string ip, uint16_t port, bool ipv6)
         addr6_.sin6_family = AF_INET6;
         addr6_.sin6_port = htons(port);
         if (inet_pton(AF_INET6, ip.c_str(), &addr6_.sin6_addr) <= 0) {
-            std::cerr << "inet_pton error: " << ip << std::endl;
+            LOG_ERROR << "inet_pton error: " << ip;
         }
     } else {
         memset(&addr_, 0, sizeof addr_);
         addr_.sin_family = AF_INET;
         addr_.sin_port = htons(port);
         if (inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr) <= 0) {
-            std::cerr << "inet_pton error: " << ip << std::endl;
+            LOG_ERROR << "inet_pton error: " << ip;
         }
     }
 }
@@ -65,18 +67,26 @@ std::string InetAddress::toIp() const {
 
 std::string InetAddress::toIpPort() const {
     char buf[64] = {0};
+    size_t len = formatIpPort(buf, sizeof buf);
+    return std::string(buf, len);
+}
+
+size_t InetAddress::formatIpPort(char* buf, size_t size) const {
+    if (size == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
     if (ipv6_) {
-        inet_ntop(AF_INET6, &addr6_.sin6_addr, buf, sizeof buf);
-        size_t end = strlen(buf);
-        uint16_t port = ntohs(addr6_.sin6_port);
-        sprintf(buf + end, ":%u", port);
+        inet_ntop(AF_INET6, &addr6_.sin6_addr, buf, static_cast<socklen_t>(size));
     } else {
-        inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof buf);
-        size_t end = strlen(buf);
-        uint16_t port = ntohs(addr_.sin_port);
-        sprintf(buf + end, ":%u", port);
+        inet_ntop(AF_INET, &addr_.sin_addr, buf, static_cast<socklen_t>(size));
     }
-    return buf;
+    size_t end = strlen(buf);
+    int n = snprintf(buf + end, size - end, ":%u", static_cast<unsigned>(port()));
+    if (n < 0) {
+        return end;
+    }
+    return std::min(end + static_cast<size_t>(n), size - 1);
 }
 
 uint16_t InetAddress::port() const {
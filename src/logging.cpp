@@ -0,0 +1,131 @@
+#include "logging.h"
+#include "timestamp.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+const size_t LogStream::kBufferSize;
+
+LogLevel Logger::s_logLevel_ = LogLevel::kInfo;
+
+namespace {
+    const char* const kLevelNames[] = {
+        "TRACE ", "DEBUG ", "INFO  ", "WARN  ", "ERROR ", "FATAL "
+    };
+
+    // 默认输出：每条日志一次write，不经过stdio的锁和缓冲
+    void defaultOutput(const char* msg, size_t len) {
+        while (len > 0) {
+            ssize_t n = ::write(STDERR_FILENO, msg, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            msg += n;
+            len -= static_cast<size_t>(n);
+        }
+    }
+
+    void defaultFlush() {
+    }
+
+    // 异步日志启动和停止时在其他线程写日志的同时切换
+    std::atomic<Logger::OutputFunc> g_output(defaultOutput);
+    std::atomic<Logger::FlushFunc> g_flush(defaultFlush);
+
+    // 每个线程缓存自己的线程号和当前秒的时间字符串，同一秒内只格式化微秒部分
+    thread_local char t_tid[16];
+    thread_local size_t t_tidLength = 0;
+    thread_local char t_time[64];
+    thread_local time_t t_lastSecond = 0;
+}
+
+LogStream& LogStream::formatInteger(long long v) {
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%lld", v);
+    return append(buf, static_cast<size_t>(n));
+}
+
+LogStream& LogStream::formatInteger(unsigned long long v) {
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%llu", v);
+    return append(buf, static_cast<size_t>(n));
+}
+
+LogStream& LogStream::operator<<(double v) {
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%.12g", v);
+    return append(buf, static_cast<size_t>(n));
+}
+
+LogStream& LogStream::operator<<(const void* p) {
+    char buf[32];
+    int n = snprintf(buf, sizeof buf, "%p", p);
+    return append(buf, static_cast<size_t>(n));
+}
+
+Logger::Logger(const char* file, int line, LogLevel level, bool saveErrno)
+    : level_(level),
+      file_(file),
+      line_(line),
+      savedErrno_(saveErrno ? errno : 0) {
+    // 时间（UTC，与Timestamp::toFormattedString()一致）
+    Timestamp now(Timestamp::now());
+    time_t seconds = static_cast<time_t>(now.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
+    int microSeconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    if (seconds != t_lastSecond) {
+        t_lastSecond = seconds;
+        struct tm tm_time;
+        gmtime_r(&seconds, &tm_time);
+        snprintf(t_time, sizeof t_time, "%4d%02d%02d %02d:%02d:%02d",
+                 tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                 tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+    }
+    char micro[16];
+    int n = snprintf(micro, sizeof micro, ".%06d ", microSeconds);
+    stream_.append(t_time, 17).append(micro, static_cast<size_t>(n));
+
+    // 线程号
+    if (t_tidLength == 0) {
+        int len = snprintf(t_tid, sizeof t_tid, "%d ", static_cast<int>(::syscall(SYS_gettid)));
+        t_tidLength = static_cast<size_t>(len);
+    }
+    stream_.append(t_tid, t_tidLength);
+
+    stream_.append(kLevelNames[static_cast<int>(level)], 6);
+}
+
+Logger::~Logger() {
+    if (savedErrno_ != 0) {
+        char buf[128];
+        // GNU版本的strerror_r返回描述字符串的指针
+        const char* msg = strerror_r(savedErrno_, buf, sizeof buf);
+        stream_ << ": " << msg << " (errno=" << savedErrno_ << ")";
+    }
+
+    // 源文件只保留文件名
+    const char* slash = strrchr(file_, '/');
+    const char* basename = slash ? slash + 1 : file_;
+    stream_ << " - " << basename << ':' << line_;
+    stream_.finish();
+
+    g_output.load()(stream_.data(), stream_.length());
+    if (level_ == LogLevel::kFatal) {
+        g_flush.load()();
+        abort();
+    }
+}
+
+void Logger::setOutput(OutputFunc out) {
+    g_output = out ? out : defaultOutput;
+}
+
+void Logger::setFlush(FlushFunc flush) {
+    g_flush = flush ? flush : defaultFlush;
+}
@@ -1,6 +1,9 @@
 #include "event_loop.h"
 #include "tcp_server.h"
 #include "inet_address.h"
+#include "logging.h"
+#include "async_logging.h"
+#include "access_log.h"
 #include <iostream>
 #include <signal.h>
 #include <memory>
@@ -8,6 +11,11 @@
 
 EventLoop* g_loop = nullptr;
 
+// SIGHUP：日志文件被logrotate等工具移走后重新打开
+void sighupHandler(int) {
+    AccessLog::instance().requestReopen();
+}
+
 // 信号处理函数
 void sigHandler(int sig) {
     printf("signal: %d\n", sig);
@@ -21,6 +29,15 @@ int main(int argc, char* argv[]) {
     // 设置信号处理
     signal(SIGINT, sigHandler);
     signal(SIGTERM, sigHandler);
+    signal(SIGHUP, sighupHandler);
+    
+    // 日志由后台线程写出，IO线程只写内存缓冲区
+    AsyncLogging::instance().start();
+
+    // 访问日志：每天或每256MB轮转一次
+    AccessLog::instance().setRotateBytes(256 * 1024 * 1024);
+    AccessLog::instance().setRotateInterval(24 * 3600);
+    AccessLog::instance().start("access.log");
     
     // 创建事件循环
     EventLoop loop;
@@ -32,7 +49,8 @@ int main(int argc, char* argv[]) {
     InetAddress listenAddr(port);
     
     // 创建TCP服务器
-    TcpServer server(&loop, listenAddr, "WebFileServer");
+    // 开启SO_REUSEPORT，每个IO线程各自接受连接
+    TcpServer server(&loop, listenAddr, "WebFileServer", true);
     
     // 设置线程池大小
     server.setThreadNum(threadNum);
@@ -40,35 +58,39 @@ int main(int argc, char* argv[]) {
     // 设置连接回调函数
     server.setConnectionCallback([](const TcpConnection::TcpConnectionPtr& conn) {
         if (conn->connected()) {
-            printf("新连接建立: %s\n", conn->peerAddress().toIpPort().c_str());
+            LOG_DEBUG << "新连接建立: " << conn->peerAddress().toIpPort();
         } else {
-            printf("连接关闭: %s\n", conn->peerAddress().toIpPort().c_str());
+            LOG_DEBUG << "连接关闭: " << conn->peerAddress().toIpPort();
         }
     });
     
     // 设置消息回调函数
-    server.setMessageCallback([](const TcpConnection::TcpConnectionPtr& conn, std::string* message) {
-        printf("收到消息: %s, 长度: %d\n", message->c_str(), static_cast<int>(message->size()));
-        conn->send(*message); // 回显消息
+    server.setMessageCallback([](const TcpConnection::TcpConnectionPtr& conn, Buffer* buffer) {
+        std::string message = buffer->retrieveAllAsString();
+        LOG_DEBUG << "收到消息: " << message << ", 长度: " << message.size();
+        conn->send(message); // 回显消息
     });
     
     // 设置写完成回调函数
     server.setWriteCompleteCallback([](const TcpConnection::TcpConnectionPtr& conn) {
-        printf("写完成回调\n");
+        LOG_TRACE << "写完成回调";
     });
     
     // 设置线程初始化回调函数
     server.setThreadInitCallback([](EventLoop* loop) {
-        printf("线程初始化\n");
+        LOG_INFO << "线程初始化";
     });
     
     // 启动服务器
-    printf("Starting HTTPServer on port %d\n", port);
-    printf("Using %d threads for handling connections\n", threadNum);
+    LOG_INFO << "Starting HTTPServer on port " << port;
+    LOG_INFO << "Using " << threadNum << " threads for handling connections";
     server.start();
     
     // 运行事件循环
     loop.loop();
     
+    // 写出剩余的日志，之后的日志（如TcpServer析构）同步输出
+    AccessLog::instance().stop();
+    AsyncLogging::instance().stop();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "metrics.h"
+#include <cstdio>
+#include <pthread.h>
+
+const int Metrics::kSubBucketBits;
+const int Metrics::kSubBucketCount;
+const int Metrics::kMaxExponent;
+const int Metrics::kBucketCount;
+
+thread_local Metrics::ShardPtr Metrics::t_shard_;
+
+namespace {
+    // Prometheus直方图的le边界（微秒）；由细粒度的桶合并得到，边界处的误差在桶的精度以内
+    const uint64_t kLatencyBounds[] = {
+        100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+        100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+    };
+
+    const double kQuantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+    // 单写者的原子变量：读出、相加、写回，不需要带lock前缀的指令
+    template <typename T>
+    inline void addRelaxed(std::atomic<T>& value, T n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void appendHeader(std::string* out, const char* name, const char* type, const char* help) {
+        out->append("# HELP ").append(name).append(" ").append(help).append("\n");
+        out->append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+
+    void appendSample(std::string* out, const char* name, const char* labels, unsigned long long value) {
+        char buf[256];
+        int n = snprintf(buf, sizeof buf, "%s%s %llu\n", name, labels, value);
+        out->append(buf, static_cast<size_t>(n));
+    }
+
+    void appendSeconds(std::string* out, const char* name, const char* labels, uint64_t microSeconds) {
+        char buf[256];
+        int n = snprintf(buf, sizeof buf, "%s%s %.6f\n", name, labels,
+                         static_cast<double>(microSeconds) / 1000000.0);
+        out->append(buf, static_cast<size_t>(n));
+    }
+}
+
+Metrics::Shard::Shard() : durationSum(0) {
+    for (std::atomic<uint64_t>& counter : counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<int64_t>& gauge : gauges) {
+        gauge.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint64_t>& count : statusCounts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+Metrics& Metrics::instance() {
+    // 不析构：其他线程退出时仍可能更新指标
+    static Metrics* metrics = new Metrics();
+    return *metrics;
+}
+
+Metrics::Shard* Metrics::threadShard() {
+    ShardPtr& shard = t_shard_;
+    if (!shard) {
+        shard.reset(new Shard());
+        char name[16] = "";
+        pthread_getname_np(pthread_self(), name, sizeof name);
+        shard->thread = name;
+        std::lock_guard<std::mutex> lock(mutex_);
+        shards_.push_back(shard);
+    }
+    return shard.get();
+}
+
+int Metrics::bucketIndex(uint64_t value) {
+    if (value < static_cast<uint64_t>(kSubBucketCount)) {
+        return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent >= kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    // 最高位之后的kSubBucketBits位决定子桶
+    int sub = static_cast<int>((value >> (exponent - kSubBucketBits)) & (kSubBucketCount - 1));
+    return (exponent - kSubBucketBits + 1) * kSubBucketCount + sub;
+}
+
+uint64_t Metrics::bucketUpperBound(int index) {
+    if (index < kSubBucketCount) {
+        return static_cast<uint64_t>(index);
+    }
+    int exponent = index / kSubBucketCount + kSubBucketBits - 1;
+    uint64_t sub = static_cast<uint64_t>(index % kSubBucketCount);
+    return ((kSubBucketCount + sub + 1) << (exponent - kSubBucketBits)) - 1;
+}
+
+void Metrics::increment(Counter counter, uint64_t n) {
+    addRelaxed(threadShard()->counters[counter], n);
+}
+
+void Metrics::adjust(Gauge gauge, int64_t delta) {
+    addRelaxed(threadShard()->gauges[gauge], delta);
+}
+
+void Metrics::recordRequest(int status, int64_t durationMicroSeconds) {
+    Shard* shard = threadShard();
+    int slot = (status >= kMinStatus && status <= kMaxStatus) ? status - kMinStatus : kStatusSlots - 1;
+    addRelaxed(shard->statusCounts[slot], static_cast<uint64_t>(1));
+    uint64_t duration = durationMicroSeconds > 0 ? static_cast<uint64_t>(durationMicroSeconds) : 0;
+    addRelaxed(shard->buckets[bucketIndex(duration)], static_cast<uint64_t>(1));
+    addRelaxed(shard->durationSum, duration);
+}
+
+void Metrics::writePrometheus(std::string* out) {
+    std::vector<ShardPtr> shards;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shards = shards_;
+    }
+
+    // 合并所有分片
+    uint64_t counters[kCounterCount] = {};
+    std::vector<uint64_t> statusCounts(kStatusSlots, 0);
+    std::vector<uint64_t> buckets(kBucketCount, 0);
+    uint64_t durationSum = 0;
+    for (const ShardPtr& shard : shards) {
+        for (int i = 0; i < kCounterCount; ++i) {
+            counters[i] += shard->counters[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < kStatusSlots; ++i) {
+            statusCounts[i] += shard->statusCounts[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < kBucketCount; ++i) {
+            buckets[i] += shard->buckets[i].load(std::memory_order_relaxed);
+        }
+        durationSum += shard->durationSum.load(std::memory_order_relaxed);
+    }
+
+    char labels[64];
+
+    appendHeader(out, "webserver_http_requests_total", "counter", "HTTP requests by response status code.");
+    for (int i = 0; i < kStatusSlots; ++i) {
+        if (statusCounts[i] == 0) {
+            continue;
+        }
+        if (i == kStatusSlots - 1) {
+            snprintf(labels, sizeof labels, "{code=\"other\"}");
+        } else {
+            snprintf(labels, sizeof labels, "{code=\"%d\"}", i + kMinStatus);
+        }
+        appendSample(out, "webserver_http_requests_total", labels, statusCounts[i]);
+    }
+
+    appendHeader(out, "webserver_bytes_received_total", "counter", "Bytes read from client sockets.");
+    appendSample(out, "webserver_bytes_received_total", "", counters[kBytesReceived]);
+    appendHeader(out, "webserver_bytes_sent_total", "counter", "Response bytes (headers and bodies).");
+    appendSample(out, "webserver_bytes_sent_total", "", counters[kBytesSent]);
+    appendHeader(out, "webserver_connections_accepted_total", "counter", "Accepted TCP connections.");
+    appendSample(out, "webserver_connections_accepted_total", "", counters[kConnectionsAccepted]);
+
+    appendHeader(out, "webserver_open_connections", "gauge", "Open connections per event loop thread.");
+    for (const ShardPtr& shard : shards) {
+        int64_t value = shard->gauges[kOpenConnections].load(std::memory_order_relaxed);
+        snprintf(labels, sizeof labels, "{thread=\"%s\"}", shard->thread.c_str());
+        appendSample(out, "webserver_open_connections", labels,
+                     static_cast<unsigned long long>(value > 0 ? value : 0));
+    }
+
+    // 请求处理耗时：细粒度的桶合并为累计的le桶
+    uint64_t total = 0;
+    for (uint64_t count : buckets) {
+        total += count;
+    }
+    appendHeader(out, "webserver_http_request_duration_seconds", "histogram",
+                 "Time from the first byte of a request to its response being queued.");
+    uint64_t cumulative = 0;
+    int index = 0;
+    for (uint64_t bound : kLatencyBounds) {
+        while (index < kBucketCount && bucketUpperBound(index) <= bound) {
+            cumulative += buckets[index++];
+        }
+        snprintf(labels, sizeof labels, "{le=\"%g\"}", static_cast<double>(bound) / 1000000.0);
+        appendSample(out, "webserver_http_request_duration_seconds_bucket", labels, cumulative);
+    }
+    appendSample(out, "webserver_http_request_duration_seconds_bucket", "{le=\"+Inf\"}", total);
+    appendSeconds(out, "webserver_http_request_duration_seconds_sum", "", durationSum);
+    appendSample(out, "webserver_http_request_duration_seconds_count", "", total);
+
+    // 分位数：取累计计数首次达到目标的桶的上界
+    appendHeader(out, "webserver_http_request_duration_quantile_seconds", "gauge",
+                 "Request duration quantiles computed from the merged histogram.");
+    for (double quantile : kQuantiles) {
+        uint64_t target = static_cast<uint64_t>(quantile * static_cast<double>(total) + 0.5);
+        if (target == 0) {
+            target = 1;
+        }
+        uint64_t value = 0;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount && total > 0; ++i) {
+            seen += buckets[i];
+            if (seen >= target) {
+                value = bucketUpperBound(i);
+                break;
+            }
+        }
+        snprintf(labels, sizeof labels, "{quantile=\"%g\"}", quantile);
+        appendSeconds(out, "webserver_http_request_duration_quantile_seconds", labels, value);
+    }
+}
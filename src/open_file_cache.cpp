@@ -0,0 +1,137 @@
+#include "open_file_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+const int OpenFileCache::kDefaultValidity;
+const size_t OpenFileCache::kDefaultMaxEntries;
+const size_t OpenFileCache::kNumShards;
+
+OpenFileCache::File::~File() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool OpenFileCache::File::isRegular() const {
+    return exists() && S_ISREG(mode_);
+}
+
+bool OpenFileCache::File::isDirectory() const {
+    return exists() && S_ISDIR(mode_);
+}
+
+OpenFileCache& OpenFileCache::instance() {
+    static OpenFileCache cache;
+    return cache;
+}
+
+OpenFileCache::OpenFileCache() : validity_(kDefaultValidity) {
+    setMaxEntries(kDefaultMaxEntries);
+}
+
+void OpenFileCache::setValidity(int seconds) {
+    validity_ = seconds;
+    if (validity_ <= 0) {
+        clear();
+    }
+}
+
+void OpenFileCache::setMaxEntries(size_t maxEntries) {
+    for (size_t i = 0; i < kNumShards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].maxEntries = (maxEntries + kNumShards - 1) / kNumShards;
+        evict(shards_[i]);
+    }
+}
+
+void OpenFileCache::clear() {
+    for (size_t i = 0; i < kNumShards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].lru.clear();
+        shards_[i].index.clear();
+    }
+}
+
+OpenFileCache::FilePtr OpenFileCache::open(const std::string& path) {
+    const int validity = validity_;
+    if (validity <= 0) {
+        return openFile(path);
+    }
+
+    Shard& shard = shardFor(path);
+    time_t now = ::time(nullptr);
+    FilePtr stale;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(path);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            if (now < it->second->validUntil) {
+                return it->second->file;
+            }
+            stale = it->second->file;
+        }
+    }
+
+    // 过期后先用stat核对，文件未变化时沿用原来的描述符，省去open/fstat/close
+    FilePtr file = (stale && isFresh(path, *stale)) ? stale : openFile(path);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(path);
+    if (it != shard.index.end()) {
+        it->second->file = file;
+        it->second->validUntil = now + validity;
+    } else {
+        Node node = { path, file, now + validity };
+        shard.lru.push_front(node);
+        shard.index[path] = shard.lru.begin();
+        evict(shard);
+    }
+    return file;
+}
+
+OpenFileCache::FilePtr OpenFileCache::openFile(const std::string& path) {
+    std::shared_ptr<File> file(new File());
+    // O_NONBLOCK避免打开FIFO等特殊文件时阻塞IO线程
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0) {
+        file->error_ = errno;
+        return file;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        file->error_ = errno;
+        ::close(fd);
+        return file;
+    }
+    file->mode_ = st.st_mode;
+    file->size_ = st.st_size;
+    file->mtime_ = st.st_mtime;
+    file->inode_ = st.st_ino;
+    // 只有普通文件保留描述符
+    if (S_ISREG(st.st_mode)) {
+        file->fd_ = fd;
+    } else {
+        ::close(fd);
+    }
+    return file;
+}
+
+bool OpenFileCache::isFresh(const std::string& path, const File& file) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) < 0) {
+        // 仍然不存在，负缓存继续有效
+        return !file.exists() && errno == file.error_;
+    }
+    return file.exists() && st.st_mode == file.mode_ && st.st_ino == file.inode_ &&
+           st.st_mtime == file.mtime_ && st.st_size == file.size_;
+}
+
+void OpenFileCache::evict(Shard& shard) {
+    while (shard.lru.size() > shard.maxEntries && !shard.lru.empty()) {
+        shard.index.erase(shard.lru.back().path);
+        shard.lru.pop_back();
+    }
+}
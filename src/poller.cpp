@@ -0,0 +1,16 @@
+#include "poller.h"
+#include "epoller.h"
+#include "uring_poller.h"
+#include "logging.h"
+#include <cstdlib>
+
+Poller* Poller::newDefaultPoller() {
+    if (::getenv("WEBSERVER_USE_URING")) {
+        Poller* poller = UringPoller::create();
+        if (poller) {
+            return poller;
+        }
+        LOG_WARN << "io_uring is not available, falling back to epoll";
+    }
+    return new Epoller();
+}
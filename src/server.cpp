@@ -8,6 +8,7 @@
 #include <arpa/inet.h>
 #include <signal.h>
 #include <errno.h>
+#include <sys/sendfile.h>
 
 // 全局服务器指针，用于信号处理
 static Server* g_server = nullptr;
@@ -105,7 +106,10 @@ void Server::stop() {
     close(pipeFd_[0]);
     close(pipeFd_[1]);
     
-    // 清空连接
+    // 清空连接（HttpConnection不再拥有套接字，需要显式关闭）
+    for (const auto& item : connections_) {
+        close(item.first);
+    }
     connections_.clear();
     
     std::cout << "WebFileServer stopped" << std::endl;
@@ -210,7 +214,7 @@ void Server::handleNewConnection() {
         // 添加到epoll
         if (epoll_->addFd(clientFd, EPOLLIN | EPOLLET | EPOLLRDHUP)) {
             // 创建HTTP连接对象
-            connections_[clientFd].reset(new HttpConnection(clientFd));
+            connections_[clientFd].reset(new Connection());
             std::cout << "New connection from " << inet_ntoa(clientAddr.sin_addr) 
                       << ":" << ntohs(clientAddr.sin_port) << std::endl;
         } else {
@@ -228,43 +232,49 @@ void Server::handleEvent(int sockFd, uint32_t events) {
         return;
     }
     
-    HttpConnection* conn = it->second.get();
+    Connection* conn = it->second.get();
     
     // 如果连接已关闭
     if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
         std::cout << "Connection closed: " << sockFd << std::endl;
         epoll_->delFd(sockFd);
         connections_.erase(it);
+        close(sockFd);
         return;
     }
     
     // 处理读事件
     if (events & EPOLLIN) {
         int savedErrno = 0;
-        ssize_t len = conn->read(&savedErrno);
+        ssize_t len = readConnection(sockFd, conn, &savedErrno);
         if (len < 0) {
             if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) {
                 std::cerr << "Read error: " << savedErrno << std::endl;
                 epoll_->delFd(sockFd);
                 connections_.erase(it);
+                close(sockFd);
             }
             return;
         } else if (len == 0) {
             std::cout << "Client closed connection: " << sockFd << std::endl;
             epoll_->delFd(sockFd);
             connections_.erase(it);
+            close(sockFd);
             return;
         }
         
         // 提交任务到线程池处理请求
         threadPool_->enqueue([conn, this, sockFd, it]() {
-            if (conn->process()) {
-                // 处理完成后，注册写事件
+            HttpRequest::ParseResult result = conn->http.process(&conn->input);
+            if (result == HttpRequest::ParseResult::COMPLETE) {
+                // 处理完成后，取出响应并注册写事件
+                takeResponse(conn);
                 epoll_->modFd(sockFd, EPOLLOUT | EPOLLET | EPOLLRDHUP);
-            } else {
+            } else if (result == HttpRequest::ParseResult::ERROR) {
                 // 处理失败，关闭连接
                 epoll_->delFd(sockFd);
                 connections_.erase(it);
+                close(sockFd);
             }
         });
     }
@@ -272,23 +282,98 @@ void Server::handleEvent(int sockFd, uint32_t events) {
     // 处理写事件
     if (events & EPOLLOUT) {
         int savedErrno = 0;
-        ssize_t len = conn->write(&savedErrno);
-        if (len < 0) {
-            if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) {
-                std::cerr << "Write error: " << savedErrno << std::endl;
-                epoll_->delFd(sockFd);
-                connections_.erase(it);
-            }
+        bool finished = writeConnection(sockFd, conn, &savedErrno);
+        if (savedErrno != 0) {
+            std::cerr << "Write error: " << savedErrno << std::endl;
+            epoll_->delFd(sockFd);
+            connections_.erase(it);
+            close(sockFd);
             return;
         }
         
-        // 检查是否所有数据都已发送
-        if (conn->isProcessing() == false && len > 0) {
-            // 重新注册读事件，等待下一次请求
+        // 所有数据都已发送：重新注册读事件，等待下一次请求；否则等待下一次可写事件
+        if (finished) {
             epoll_->modFd(sockFd, EPOLLIN | EPOLLET | EPOLLRDHUP);
-            conn->reset();
+            conn->http.reset();
+        }
+    }
+}
+
+// 读取数据（边沿触发，读到EAGAIN或对方关闭为止）
+ssize_t Server::readConnection(int sockFd, Connection* conn, int* savedErrno) {
+    ssize_t totalRead = 0;
+    while (true) {
+        int err = 0;
+        ssize_t len = conn->input.readFd(sockFd, &err);
+        if (len < 0) {
+            if (err == EAGAIN || err == EWOULDBLOCK) {
+                break; // 非阻塞IO，没有更多数据可读
+            }
+            if (err == EINTR) {
+                continue;
+            }
+            *savedErrno = err;
+            return -1;
+        } else if (len == 0) {
+            break; // 对方关闭连接
         }
+        totalRead += len;
     }
+    return totalRead;
+}
+
+// 取出响应：响应头、响应体（缓存内容或字符串）和尾部拷贝到发送缓冲区，文件响应体留给sendfile
+void Server::takeResponse(Connection* conn) {
+    std::string header, body, trailer;
+    conn->http.takeResponse(&header, &body, &trailer);
+    StaticFileCache::EntryPtr content = conn->http.takeResponseContent();
+    conn->output.append(header);
+    if (content) {
+        conn->output.append(content->data(), content->size());
+    }
+    conn->output.append(body);
+    conn->output.append(trailer);
+    conn->file = conn->http.takeResponseFile();
+    conn->fileOffset = 0;
+}
+
+// 写入数据，部分发送时记录进度，下一次可写事件从断点继续
+bool Server::writeConnection(int sockFd, Connection* conn, int* savedErrno) {
+    while (conn->output.readableBytes() > 0) {
+        ssize_t n = ::write(sockFd, conn->output.peek(), conn->output.readableBytes());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                *savedErrno = errno;
+            }
+            return false;
+        }
+        conn->output.retrieve(static_cast<size_t>(n));
+    }
+
+    if (conn->file) {
+        while (conn->fileOffset < conn->file->size()) {
+            size_t remaining = static_cast<size_t>(conn->file->size() - conn->fileOffset);
+            ssize_t n = ::sendfile(sockFd, conn->file->fd(), &conn->fileOffset, remaining);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    *savedErrno = errno;
+                }
+                return false;
+            }
+            if (n == 0) {
+                break; // 文件被截断
+            }
+        }
+        conn->file.reset();
+        conn->fileOffset = 0;
+    }
+    return true;
 }
 
 // 处理信号
@@ -0,0 +1,76 @@
+#include "slab_pool.h"
+#include <cassert>
+#include <new>
+
+const size_t SlabPool::kDefaultSlotsPerSlab;
+
+namespace {
+    // 槽按该值对齐，满足任意基本类型的对齐要求
+    const size_t kSlotAlignment = alignof(max_align_t);
+}
+
+SlabPool::SlabPool(size_t slotsPerSlab)
+    : slotsPerSlab_(slotsPerSlab > 0 ? slotsPerSlab : kDefaultSlotsPerSlab),
+      slotSize_(0),
+      slotsInUse_(0),
+      freeList_(nullptr) {
+}
+
+SlabPool::~SlabPool() {
+    assert(slotsInUse_ == 0);
+    for (char* slab : slabs_) {
+        ::operator delete(slab);
+    }
+}
+
+void* SlabPool::allocate(size_t size) {
+    size_t rounded = (size + kSlotAlignment - 1) / kSlotAlignment * kSlotAlignment;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (slotSize_ == 0) {
+            slotSize_ = rounded;
+        }
+        if (rounded == slotSize_) {
+            if (!freeList_) {
+                // 申请新的一块，切分后挂到空闲链表
+                char* slab = static_cast<char*>(::operator new(slotSize_ * slotsPerSlab_));
+                slabs_.push_back(slab);
+                for (size_t i = slotsPerSlab_; i > 0; --i) {
+                    FreeSlot* slot = reinterpret_cast<FreeSlot*>(slab + (i - 1) * slotSize_);
+                    slot->next = freeList_;
+                    freeList_ = slot;
+                }
+            }
+            FreeSlot* slot = freeList_;
+            freeList_ = slot->next;
+            ++slotsInUse_;
+            return slot;
+        }
+    }
+    return ::operator new(size);
+}
+
+void SlabPool::deallocate(void* p, size_t size) {
+    size_t rounded = (size + kSlotAlignment - 1) / kSlotAlignment * kSlotAlignment;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (rounded == slotSize_) {
+            FreeSlot* slot = static_cast<FreeSlot*>(p);
+            slot->next = freeList_;
+            freeList_ = slot;
+            --slotsInUse_;
+            return;
+        }
+    }
+    ::operator delete(p);
+}
+
+size_t SlabPool::slabCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slabs_.size();
+}
+
+size_t SlabPool::slotsInUse() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slotsInUse_;
+}
@@ -1,4 +1,5 @@
 #include "socket.h"
+#include "logging.h"
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/socket.h>
@@ -6,7 +7,6 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-#include <iostream>
 
 Socket::~Socket() {
     if (sockfd_ >= 0) {
@@ -18,16 +18,14 @@ Socket::~Socket() {
 void Socket::bindAddress(const InetAddress& localaddr) {
     int ret = ::bind(sockfd_, localaddr.getSockAddr(), localaddr.getSockAddrLen());
     if (ret < 0) {
-        std::cerr << "Socket::bindAddress error" << std::endl;
-        abort();
+        LOG_SYSFATAL << "Socket::bindAddress error";
     }
 }
 
 void Socket::listen() {
     int ret = ::listen(sockfd_, SOMAXCONN);
     if (ret < 0) {
-        std::cerr << "Socket::listen error" << std::endl;
-        abort();
+        LOG_SYSFATAL << "Socket::listen error";
     }
 }
 
@@ -45,7 +43,10 @@ int Socket::accept(InetAddress* peeraddr) {
         }
     } else {
         int savedErrno = errno;
-        std::cerr << "Socket::accept error" << std::endl;
+        // 批量accept时监听队列取空是正常情况，不记录
+        if (savedErrno != EAGAIN) {
+            LOG_SYSERR << "Socket::accept error";
+        }
         switch (savedErrno) {
             case EAGAIN:
             case ECONNABORTED:
@@ -57,8 +58,7 @@ int Socket::accept(InetAddress* peeraddr) {
                 errno = savedErrno;
                 break;
             default:
-                std::cerr << "Unexpected error in Socket::accept" << std::endl;
-                abort();
+                LOG_FATAL << "Unexpected error in Socket::accept";
                 break;
         }
     }
@@ -67,7 +67,7 @@ int Socket::accept(InetAddress* peeraddr) {
 
 void Socket::shutdownWrite() {
     if (::shutdown(sockfd_, SHUT_WR) < 0) {
-        std::cerr << "Socket::shutdownWrite error" << std::endl;
+        LOG_SYSERR << "Socket::shutdownWrite error";
     }
 }
 
@@ -94,8 +94,7 @@ void Socket::setKeepAlive(bool on) {
 int Socket::createNonblockingOrDie(sa_family_t family) {
     int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
     if (sockfd < 0) {
-        std::cerr << "Socket::createNonblockingOrDie error" << std::endl;
-        abort();
+        LOG_SYSFATAL << "Socket::createNonblockingOrDie error";
     }
     return sockfd;
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "static_file_cache.h"
+#include <unistd.h>
+#include <algorithm>
+
+const size_t StaticFileCache::kMaxCachedFileSize;
+const size_t StaticFileCache::kDefaultCapacity;
+const size_t StaticFileCache::kNumShards;
+
+StaticFileCache& StaticFileCache::instance() {
+    static StaticFileCache cache;
+    return cache;
+}
+
+StaticFileCache::StaticFileCache() {
+    setCapacity(kDefaultCapacity);
+}
+
+void StaticFileCache::setCapacity(size_t bytes) {
+    for (size_t i = 0; i < kNumShards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].capacity = bytes / kNumShards;
+        evict(shards_[i]);
+    }
+}
+
+void StaticFileCache::clear() {
+    for (size_t i = 0; i < kNumShards; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mutex);
+        shards_[i].lru.clear();
+        shards_[i].index.clear();
+        shards_[i].bytes = 0;
+    }
+}
+
+StaticFileCache::EntryPtr StaticFileCache::get(const std::string& path,
+                                               const OpenFileCache::FilePtr& file) {
+    if (!file->isRegular() || static_cast<size_t>(file->size()) > kMaxCachedFileSize) {
+        return EntryPtr();
+    }
+
+    Shard& shard = shardFor(path);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(path);
+        if (it != shard.index.end() && isFresh(*it->second->second, *file)) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return it->second->second;
+        }
+    }
+
+    // 加载在锁外进行，磁盘IO不阻塞同一分段上的其他查找
+    EntryPtr loaded = load(path, *file);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(path);
+    if (it != shard.index.end()) {
+        shard.bytes -= it->second->second->size();
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+    if (loaded) {
+        insert(shard, path, loaded);
+    }
+    return loaded;
+}
+
+bool StaticFileCache::isFresh(const Entry& entry, const OpenFileCache::File& file) {
+    return file.mtime() == entry.mtime_ && file.inode() == entry.inode_ &&
+           static_cast<size_t>(file.size()) == entry.size();
+}
+
+StaticFileCache::EntryPtr StaticFileCache::load(const std::string& path,
+                                                const OpenFileCache::File& file) {
+    std::shared_ptr<Entry> entry(new Entry());
+    size_t size = static_cast<size_t>(file.size());
+    // 使用pread，不改变共享描述符的文件位置；读到的长度不符（文件正被修改）时不缓存
+    entry->content_.resize(size);
+    size_t nread = 0;
+    while (nread < size) {
+        ssize_t n = ::pread(file.fd(), &entry->content_[nread], size - nread,
+                            static_cast<off_t>(nread));
+        if (n <= 0) {
+            break;
+        }
+        nread += static_cast<size_t>(n);
+    }
+    if (nread != size) {
+        return EntryPtr();
+    }
+
+    entry->mtime_ = file.mtime();
+    entry->inode_ = file.inode();
+    entry->mimeType_ = mimeType(path);
+    entry->headerFields_ = "Content-Type: " + entry->mimeType_ + "\r\n";
+    entry->headerFields_ += "Content-Length: " + std::to_string(size) + "\r\n";
+    return entry;
+}
+
+void StaticFileCache::insert(Shard& shard, const std::string& path, const EntryPtr& entry) {
+    // 超过分段预算的文件不缓存，但仍返回给调用方使用
+    if (entry->size() > shard.capacity) {
+        return;
+    }
+    shard.lru.push_front(std::make_pair(path, entry));
+    shard.index[path] = shard.lru.begin();
+    shard.bytes += entry->size();
+    evict(shard);
+}
+
+void StaticFileCache::evict(Shard& shard) {
+    while (shard.bytes > shard.capacity && !shard.lru.empty()) {
+        LruList::iterator last = --shard.lru.end();
+        shard.bytes -= last->second->size();
+        shard.index.erase(last->first);
+        shard.lru.erase(last);
+    }
+}
+
+std::string StaticFileCache::mimeType(const std::string& path) {
+    size_t dotPos = path.find_last_of('.');
+    if (dotPos == std::string::npos || dotPos == path.size() - 1) {
+        return "application/octet-stream";
+    }
+    std::string extension = path.substr(dotPos + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (extension == "html" || extension == "htm") return "text/html; charset=utf-8";
+    if (extension == "css") return "text/css; charset=utf-8";
+    if (extension == "js") return "application/javascript; charset=utf-8";
+    if (extension == "json") return "application/json; charset=utf-8";
+    if (extension == "png") return "image/png";
+    if (extension == "jpg" || extension == "jpeg") return "image/jpeg";
+    if (extension == "gif") return "image/gif";
+    if (extension == "svg") return "image/svg+xml";
+    if (extension == "pdf") return "application/pdf";
+    if (extension == "txt") return "text/plain; charset=utf-8";
+    if (extension == "xml") return "application/xml";
+    if (extension == "zip") return "application/zip";
+    if (extension == "mp3") return "audio/mpeg";
+    if (extension == "mp4") return "video/mp4";
+    // 默认MIME类型
+    return "application/octet-stream";
+}
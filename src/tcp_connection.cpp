@@ -1,44 +1,117 @@
 #include "tcp_connection.h"
+#include "logging.h"
 #include "event_loop.h"
+#include "poller.h"
 #include "http_connection.h"
-#include <iostream>
+#include "timing_wheel.h"
+#include "access_log.h"
+#include "metrics.h"
 #include <cstring>
 #include <sstream>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <cassert>
+#include <vector>
+#include <algorithm>
 
-TcpConnection::TcpConnection(EventLoop* loop, const std::string& nameArg, int sockfd,
-                           const InetAddress& localAddr, const InetAddress& peerAddr)
+namespace {
+    // handleWrite中一次writev最多聚合的数据段数
+    const int kMaxWriteIov = 16;
+    // 一次sendfile最多发送的字节数，避免单个连接长时间占用IO线程
+    const size_t kMaxSendfileChunk = 1024 * 1024;
+    // 边沿触发时一次事件中最多的读/写次数，用完后让出IO线程，剩下的排到本轮事件处理之后继续
+    const int kEdgeTriggeredReadBudget = 16;
+    const int kEdgeTriggeredWriteBudget = 16;
+
+    // 连接销毁时把输入输出缓冲区留给本线程之后创建的连接，连接频繁创建销毁时缓冲区不再每次申请内存
+    // 每个线程最多保留kMaxSpareBuffers个，超过kMaxSpareBufferSize的缓冲区直接释放
+    const size_t kMaxSpareBuffers = 256;
+    const size_t kMaxSpareBufferSize = 16 * 1024;
+    thread_local std::vector<Buffer> t_spareBuffers;
+
+    Buffer takeSpareBuffer() {
+        if (t_spareBuffers.empty()) {
+            return Buffer();
+        }
+        Buffer buffer(std::move(t_spareBuffers.back()));
+        t_spareBuffers.pop_back();
+        return buffer;
+    }
+
+    void recycleBuffer(Buffer* buffer) {
+        if (buffer->internalCapacity() > kMaxSpareBufferSize) {
+            return;
+        }
+        if (t_spareBuffers.capacity() == 0) {
+            t_spareBuffers.reserve(kMaxSpareBuffers);
+        }
+        if (t_spareBuffers.size() < kMaxSpareBuffers) {
+            buffer->retrieveAll();
+            t_spareBuffers.push_back(std::move(*buffer));
+        }
+    }
+}
+
+// 完成模式的发送请求：sendmsg引用的iovec在请求完成前必须有效，随连接分配一次、重复使用
+struct TcpConnection::SendRequest {
+    struct msghdr msg;
+    struct iovec vec[kMaxWriteIov];
+};
+
+TcpConnection::TcpConnection(EventLoop* loop, uint64_t id, int sockfd,
+                           const InetAddress& localAddr, const InetAddress& peerAddr,
+                           const CallbacksPtr& callbacks)
     : loop_(loop),
-      name_(nameArg),
+      id_(id),
       state_(kDisconnected),
-      socket_(new Socket(sockfd)),
-      channel_(new Channel(loop, sockfd)),
+      socket_(sockfd),
+      channel_(loop, sockfd),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64*1024*1024) {
+      callbacks_(callbacks),
+      idleTimeout_(0.0),
+      headerTimeout_(0.0),
+      wheelGeneration_(0),
+      highWaterMark_(64*1024*1024),
+      inputBuffer_(takeSpareBuffer()),
+      outputBuffer_(takeSpareBuffer()),
+      outputChunkBytes_(0),
+      reportedPendingBytes_(0),
+      readResumeQueued_(false),
+      writeResumeQueued_(false),
+      completionPoller_(nullptr),
+      sendInFlight_(false) {
+
     // 设置Channel的回调函数
-    channel_->setReadCallback(
+    channel_.setReadCallback(
         std::bind(&TcpConnection::handleRead, this));
-    channel_->setWriteCallback(
+    channel_.setWriteCallback(
         std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(
+    channel_.setCloseCallback(
         std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(
+    channel_.setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
 
     // 输出连接信息
-    std::cout << "TcpConnection::ctor[" << name_ << "] at " << this
-              << " fd=" << sockfd << std::endl;
+    LOG_DEBUG << "TcpConnection::ctor[" << id_ << "] at " << this
+              << " fd=" << sockfd;
 
     // 设置TCP_NODELAY选项，禁用Nagle算法
-    socket_->setTcpNoDelay(true);
+    socket_.setTcpNoDelay(true);
 }
 
 TcpConnection::~TcpConnection() {
-    std::cout << "TcpConnection::dtor[" << name_ << "] at " << this
-              << " fd=" << channel_->fd()
-              << " state=" << state_ << std::endl;
+    LOG_DEBUG << "TcpConnection::dtor[" << id_ << "] at " << this
+              << " fd=" << channel_.fd()
+              << " state=" << state_;
+    recycleBuffer(&inputBuffer_);
+    recycleBuffer(&outputBuffer_);
+}
+
+void TcpConnection::setMaxKeepAliveRequests(int maxRequests) {
+    httpConnection_.setMaxRequests(maxRequests);
 }
 
 void TcpConnection::send(const void* message, int len) {
@@ -72,23 +145,23 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
     bool faultError = false;
 
     if (state_ == kDisconnected) {
-        std::cerr << "disconnected, give up writing" << std::endl;
+        LOG_WARN << "disconnected, give up writing";
         return;
     }
 
-    // 如果输出缓冲区为空，尝试直接写入
-    if (!channel_->isWriting() && outputBuffer_.empty()) {
-        nwrote = ::write(channel_->fd(), data, len);
+    // 如果没有待发送的数据，尝试直接写入
+    if (canWriteDirectly()) {
+        nwrote = ::write(channel_.fd(), data, len);
         if (nwrote >= 0) {
             remaining = len - nwrote;
-            if (remaining == 0 && writeCompleteCallback_) {
+            if (remaining == 0 && callbacks_->writeComplete) {
                 loop_->queueInLoop(
-                    std::bind(writeCompleteCallback_, shared_from_this()));
+                    std::bind(callbacks_->writeComplete, shared_from_this()));
             }
         } else {
             nwrote = 0;
             if (errno != EWOULDBLOCK) {
-                std::cerr << "TcpConnection::sendInLoop error" << std::endl;
+                LOG_SYSERR << "TcpConnection::sendInLoop error";
                 if (errno == EPIPE || errno == ECONNRESET) {
                     faultError = true;
                 }
@@ -99,14 +172,339 @@ void TcpConnection::sendInLoop(const void* data, size_t len) {
     assert(remaining <= len);
     // 如果还有数据未发送，添加到输出缓冲区
     if (!faultError && remaining > 0) {
-        size_t oldLen = outputBuffer_.size();
-        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
+        size_t oldLen = pendingOutputBytes();
+        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && callbacks_->highWaterMark) {
+            loop_->queueInLoop(
+                std::bind(callbacks_->highWaterMark, shared_from_this(), oldLen + remaining));
+        }
+        if (outputChunks_.empty() && !sendInFlight_) {
+            outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
+        } else {
+            // 输出队列非空时必须排在队列之后，保证发送顺序；
+            // 发送请求未完成时不能追加到outputBuffer_（扩容会移动请求引用的数据）
+            OutputChunk chunk;
+            chunk.data.assign(static_cast<const char*>(data) + nwrote, remaining);
+            outputChunks_.push_back(std::move(chunk));
+            outputChunkBytes_ += remaining;
+        }
+        startWriting();
+        reportPendingOutput();
+    }
+}
+
+void TcpConnection::sendSegments(std::string&& header, std::string&& body,
+                                 std::string&& trailer) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendSegmentsInLoop(&header, &body, &trailer);
+        } else {
+            // 跨线程时把数据段转移到堆上，交给IO线程发送
+            std::shared_ptr<std::vector<std::string>> segments(new std::vector<std::string>(3));
+            (*segments)[0].swap(header);
+            (*segments)[1].swap(body);
+            (*segments)[2].swap(trailer);
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, segments]() {
+                self->sendSegmentsInLoop(&(*segments)[0], &(*segments)[1], &(*segments)[2]);
+            });
+        }
+    }
+}
+
+void TcpConnection::sendSegmentsInLoop(std::string* header, std::string* body,
+                                       std::string* trailer) {
+    loop_->assertInLoopThread();
+    std::string* segments[] = { header, body, trailer };
+    const size_t total = header->size() + body->size() + trailer->size();
+    size_t nwrote = 0;
+    bool faultError = false;
+
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    // 如果没有待发送的数据，尝试用writev直接写出所有数据段
+    if (canWriteDirectly()) {
+        struct iovec vec[3];
+        int iovcnt = 0;
+        for (std::string* segment : segments) {
+            if (!segment->empty()) {
+                vec[iovcnt].iov_base = &(*segment)[0];
+                vec[iovcnt].iov_len = segment->size();
+                ++iovcnt;
+            }
+        }
+        ssize_t n = iovcnt > 0 ? ::writev(channel_.fd(), vec, iovcnt) : 0;
+        if (n >= 0) {
+            nwrote = static_cast<size_t>(n);
+            if (nwrote == total && callbacks_->writeComplete) {
+                loop_->queueInLoop(
+                    std::bind(callbacks_->writeComplete, shared_from_this()));
+            }
+        } else {
+            if (errno != EWOULDBLOCK) {
+                LOG_SYSERR << "TcpConnection::sendSegmentsInLoop error";
+                if (errno == EPIPE || errno == ECONNRESET) {
+                    faultError = true;
+                }
+            }
+        }
+    }
+
+    // 未写完的数据段整体转移到输出队列，已写出的部分用offset跳过
+    if (!faultError && nwrote < total) {
+        size_t oldLen = pendingOutputBytes();
+        size_t remaining = total - nwrote;
+        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && callbacks_->highWaterMark) {
+            loop_->queueInLoop(
+                std::bind(callbacks_->highWaterMark, shared_from_this(), oldLen + remaining));
+        }
+        for (std::string* segment : segments) {
+            if (nwrote >= segment->size()) {
+                nwrote -= segment->size();
+                continue;
+            }
+            OutputChunk chunk;
+            chunk.data.swap(*segment);
+            chunk.offset = nwrote;
+            outputChunks_.push_back(std::move(chunk));
+            nwrote = 0;
+        }
+        outputChunkBytes_ += remaining;
+        startWriting();
+        reportPendingOutput();
+    }
+}
+
+void TcpConnection::sendShared(std::string&& header, const std::shared_ptr<const void>& owner,
+                               const char* data, size_t len) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendSharedInLoop(&header, owner, data, len);
+        } else {
+            std::shared_ptr<std::string> headerPtr(new std::string());
+            headerPtr->swap(header);
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, headerPtr, owner, data, len]() {
+                self->sendSharedInLoop(headerPtr.get(), owner, data, len);
+            });
+        }
+    }
+}
+
+void TcpConnection::sendSharedInLoop(std::string* header, const std::shared_ptr<const void>& owner,
+                                     const char* data, size_t len) {
+    loop_->assertInLoopThread();
+    const size_t total = header->size() + len;
+    size_t nwrote = 0;
+    bool faultError = false;
+
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    // 如果没有待发送的数据，header和共享内容用writev一次写出
+    if (canWriteDirectly()) {
+        struct iovec vec[2];
+        vec[0].iov_base = &(*header)[0];
+        vec[0].iov_len = header->size();
+        vec[1].iov_base = const_cast<char*>(data);
+        vec[1].iov_len = len;
+        ssize_t n = ::writev(channel_.fd(), vec, 2);
+        if (n >= 0) {
+            nwrote = static_cast<size_t>(n);
+            if (nwrote == total && callbacks_->writeComplete) {
+                loop_->queueInLoop(
+                    std::bind(callbacks_->writeComplete, shared_from_this()));
+            }
+        } else {
+            if (errno != EWOULDBLOCK) {
+                LOG_SYSERR << "TcpConnection::sendSharedInLoop error";
+                if (errno == EPIPE || errno == ECONNRESET) {
+                    faultError = true;
+                }
+            }
+        }
+    }
+
+    // 未写完的部分挂到输出队列，共享内容只保存引用
+    if (!faultError && nwrote < total) {
+        size_t oldLen = pendingOutputBytes();
+        size_t remaining = total - nwrote;
+        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && callbacks_->highWaterMark) {
             loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+                std::bind(callbacks_->highWaterMark, shared_from_this(), oldLen + remaining));
+        }
+        if (nwrote < header->size()) {
+            OutputChunk chunk;
+            chunk.data.swap(*header);
+            chunk.offset = nwrote;
+            outputChunks_.push_back(std::move(chunk));
+            nwrote = 0;
+        } else {
+            nwrote -= header->size();
+        }
+        if (nwrote < len) {
+            OutputChunk chunk;
+            chunk.owner = owner;
+            chunk.ref = data;
+            chunk.refLength = len;
+            chunk.offset = nwrote;
+            outputChunks_.push_back(std::move(chunk));
+        }
+        outputChunkBytes_ += remaining;
+        startWriting();
+        reportPendingOutput();
+    }
+}
+
+void TcpConnection::sendFile(std::string&& header, const std::shared_ptr<const void>& owner,
+                             int fd, off_t offset, size_t count) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendFileInLoop(&header, owner, fd, offset, count);
+        } else {
+            std::shared_ptr<std::string> headerPtr(new std::string());
+            headerPtr->swap(header);
+            TcpConnectionPtr self(shared_from_this());
+            loop_->runInLoop([self, headerPtr, owner, fd, offset, count]() {
+                self->sendFileInLoop(headerPtr.get(), owner, fd, offset, count);
+            });
+        }
+    }
+}
+
+void TcpConnection::sendFileInLoop(std::string* header, const std::shared_ptr<const void>& owner,
+                                   int fd, off_t offset, size_t count) {
+    loop_->assertInLoopThread();
+    size_t headerWrote = 0;
+    bool faultError = false;
+
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    // 如果没有待发送的数据，直接发送header和文件内容
+    if (canWriteDirectly()) {
+        ssize_t n = 0;
+        if (!header->empty()) {
+            // MSG_MORE让内核把header和随后的文件内容合并成尽量少的报文
+            n = ::send(channel_.fd(), header->data(), header->size(), count > 0 ? MSG_MORE : 0);
+        }
+        if (n >= 0) {
+            headerWrote = static_cast<size_t>(n);
+            if (headerWrote == header->size() && count > 0) {
+                // sendfile会推进offset
+                n = ::sendfile(channel_.fd(), fd, &offset, std::min(count, kMaxSendfileChunk));
+                if (n > 0) {
+                    count -= static_cast<size_t>(n);
+                }
+            }
+        }
+        if (n < 0 && errno != EWOULDBLOCK) {
+            LOG_SYSERR << "TcpConnection::sendFileInLoop error";
+            if (errno == EPIPE || errno == ECONNRESET) {
+                faultError = true;
+            }
+        }
+        if (!faultError && headerWrote == header->size() && count == 0 && callbacks_->writeComplete) {
+            loop_->queueInLoop(
+                std::bind(callbacks_->writeComplete, shared_from_this()));
+        }
+    }
+
+    if (faultError) {
+        return;
+    }
+
+    // 未发送完的header和文件内容挂到输出队列
+    size_t remaining = header->size() - headerWrote + count;
+    if (remaining > 0) {
+        size_t oldLen = pendingOutputBytes();
+        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && callbacks_->highWaterMark) {
+            loop_->queueInLoop(
+                std::bind(callbacks_->highWaterMark, shared_from_this(), oldLen + remaining));
+        }
+        if (headerWrote < header->size()) {
+            OutputChunk chunk;
+            chunk.data.swap(*header);
+            chunk.offset = headerWrote;
+            outputChunks_.push_back(std::move(chunk));
+        }
+        if (count > 0) {
+            OutputChunk chunk;
+            chunk.owner = owner;
+            chunk.fileFd = fd;
+            chunk.fileOffset = offset;
+            chunk.fileRemaining = count;
+            outputChunks_.push_back(std::move(chunk));
+        }
+        outputChunkBytes_ += remaining;
+        startWriting();
+        reportPendingOutput();
+    }
+}
+
+ssize_t TcpConnection::writeMemoryChunks() {
+    // 输出缓冲区和输出队列中连续的内存数据段通过writev一次写出，遇到文件数据段为止
+    struct iovec vec[kMaxWriteIov];
+    int iovcnt = 0;
+    if (outputBuffer_.readableBytes() > 0) {
+        vec[iovcnt].iov_base = const_cast<char*>(outputBuffer_.peek());
+        vec[iovcnt].iov_len = outputBuffer_.readableBytes();
+        ++iovcnt;
+    }
+    for (auto it = outputChunks_.begin();
+         it != outputChunks_.end() && it->fileFd < 0 && iovcnt < kMaxWriteIov; ++it) {
+        vec[iovcnt].iov_base = const_cast<char*>(it->begin() + it->offset);
+        vec[iovcnt].iov_len = it->size() - it->offset;
+        ++iovcnt;
+    }
+    ssize_t n = ::writev(channel_.fd(), vec, iovcnt);
+    if (n > 0) {
+        // 只移动读指针和写游标，不搬移剩余数据
+        retrieveOutput(static_cast<size_t>(n));
+    }
+    return n;
+}
+
+ssize_t TcpConnection::writeFileChunk() {
+    // 从上次的文件偏移处继续sendfile
+    OutputChunk& chunk = outputChunks_.front();
+    ssize_t n = ::sendfile(channel_.fd(), chunk.fileFd, &chunk.fileOffset,
+                           std::min(chunk.fileRemaining, kMaxSendfileChunk));
+    if (n > 0) {
+        chunk.fileRemaining -= static_cast<size_t>(n);
+        outputChunkBytes_ -= static_cast<size_t>(n);
+        if (chunk.fileRemaining == 0) {
+            outputChunks_.pop_front();
         }
-        outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
-        if (!channel_->isWriting()) {
-            channel_->enableWriting();
+    }
+    return n;
+}
+
+void TcpConnection::retrieveOutput(size_t n) {
+    // 先消费输出缓冲区，只移动读指针
+    size_t fromBuffer = std::min(n, outputBuffer_.readableBytes());
+    outputBuffer_.retrieve(fromBuffer);
+    n -= fromBuffer;
+
+    // 再推进输出队列的写游标，写完的数据段出队
+    while (n > 0) {
+        assert(!outputChunks_.empty() && outputChunks_.front().fileFd < 0);
+        OutputChunk& chunk = outputChunks_.front();
+        size_t left = chunk.size() - chunk.offset;
+        if (n >= left) {
+            n -= left;
+            outputChunkBytes_ -= left;
+            outputChunks_.pop_front();
+        } else {
+            chunk.offset += n;
+            outputChunkBytes_ -= n;
+            n = 0;
         }
     }
 }
@@ -121,8 +519,8 @@ void TcpConnection::shutdown() {
 
 void TcpConnection::shutdownInLoop() {
     loop_->assertInLoopThread();
-    if (!channel_->isWriting()) {
-        socket_->shutdownWrite();
+    if (!writing()) {
+        socket_.shutdownWrite();
     }
 }
 
@@ -147,103 +545,445 @@ void TcpConnection::connectEstablished() {
     assert(state_ == kDisconnected || state_ == kConnecting);
     setState(kConnected);
     // 暂时移除tie()方法调用，因为Channel类没有该方法
-    channel_->enableReading();
+    // 完成模式时Poller持续把数据接收到inputBuffer_，不关注可读事件；
+    // 边沿触发时可写事件一直开启，待发送数据的有无不再通过epoll_ctl切换
+    Poller* poller = loop_->completionPoller();
+    if (poller != nullptr && poller->startReceiving(&channel_, &inputBuffer_)) {
+        completionPoller_ = poller;
+        channel_.setEdgeTriggered(false);
+    } else if (channel_.edgeTriggered()) {
+        channel_.enableReadingAndWriting();
+    } else {
+        channel_.enableReading();
+    }
+    Metrics::instance().adjust(Metrics::kOpenConnections, 1);
 
-    if (connectionCallback_) {
-        connectionCallback_(shared_from_this());
+    lastActive_ = Timestamp::now();
+    // 请求头超时从建立连接开始计时，连接后迟迟不发送请求的客户端同样会被关闭
+    if (headerTimeout_ > 0.0) {
+        headerStart_ = lastActive_;
     }
+    std::shared_ptr<TimingWheel> wheel(timingWheel_.lock());
+    if (wheel) {
+        wheel->schedule(this);
+    }
+
+    if (callbacks_->connection) {
+        callbacks_->connection(shared_from_this());
+    }
+}
+
+Timestamp TcpConnection::deadline() const {
+    Timestamp result;
+    if (idleTimeout_ > 0.0 && lastActive_.valid()) {
+        result = addTime(lastActive_, idleTimeout_);
+    }
+    if (headerTimeout_ > 0.0 && headerStart_.valid()) {
+        Timestamp headerDeadline = addTime(headerStart_, headerTimeout_);
+        if (!result.valid() || headerDeadline < result) {
+            result = headerDeadline;
+        }
+    }
+    return result;
 }
 
 void TcpConnection::connectDestroyed() {
     loop_->assertInLoopThread();
     if (state_ == kConnected) {
         setState(kDisconnected);
-        if (channel_) {
-            channel_->disableAll();
-        }
-        if (connectionCallback_) {
-            connectionCallback_(shared_from_this());
+        channel_.disableAll();
+        if (callbacks_->connection) {
+            callbacks_->connection(shared_from_this());
         }
     }
     // 使用EventLoop的removeChannel()方法替代Channel的remove()方法
-    if (loop_ && channel_) {
-        loop_->removeChannel(channel_.get());
+    loop_->removeChannel(&channel_);
+
+    // 未发出的数据不再计入所属线程的负载
+    loop_->addPendingOutputBytes(-static_cast<int64_t>(reportedPendingBytes_));
+    reportedPendingBytes_ = 0;
+    loop_->connectionRemoved();
+    Metrics::instance().adjust(Metrics::kOpenConnections, -1);
+}
+
+void TcpConnection::logAccess(Timestamp requestStart, Timestamp finish, size_t bytes) {
+    AccessLog::Record record;
+    record.time = finish;
+    record.peer = &peerAddr_;
+    record.method = httpConnection_.requestMethod();
+    record.path = httpConnection_.requestPath();
+    record.status = httpConnection_.responseStatus();
+    record.bytes = bytes;
+    record.durationMicroSeconds = record.time.microSecondsSinceEpoch() - requestStart.microSecondsSinceEpoch();
+    AccessLog::instance().append(record);
+}
+
+void TcpConnection::reportPendingOutput() {
+    size_t pending = pendingOutputBytes();
+    if (pending != reportedPendingBytes_) {
+        loop_->addPendingOutputBytes(static_cast<int64_t>(pending) -
+                                     static_cast<int64_t>(reportedPendingBytes_));
+        reportedPendingBytes_ = pending;
     }
 }
 
 void TcpConnection::handleRead() {
     loop_->assertInLoopThread();
+    // 同一批事件中可能已经关闭（如先处理了EPOLLHUP）
+    if (state_ == kDisconnected) {
+        return;
+    }
+    if (completionPoller_ != nullptr) {
+        handleReadCompletion();
+        return;
+    }
+    // 水平触发时每次事件读一次；边沿触发时读到EAGAIN为止，但不超过预算
+    const bool edgeTriggered = channel_.edgeTriggered();
+    const int budget = edgeTriggered ? kEdgeTriggeredReadBudget : 1;
+    for (int i = 0; i < budget; ++i) {
+        int savedErrno = 0;
+        size_t writable = inputBuffer_.writableBytes();
+        // 直接读入输入缓冲区，空间不足时readv使用栈上的额外缓冲区
+        ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno);
+        
+        if (n > 0) {
+            Timestamp now(Timestamp::now());
+            lastActive_ = now;
+            Metrics::instance().increment(Metrics::kBytesReceived, static_cast<uint64_t>(n));
+            processInput(now);
+            // 没有读满说明接收缓冲区已读空，之后到达的数据会产生新的边沿，不必再读一次等EAGAIN
+            if (static_cast<size_t>(n) < writable) {
+                return;
+            }
+        } else if (n == 0) {
+            handleClose();
+            return;
+        } else if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+            return;
+        } else if (savedErrno == EINTR) {
+            continue;
+        } else {
+            // 连接被重置等错误：epoll同时报告EPOLLIN和EPOLLHUP时Channel不会调用关闭回调，
+            // 边沿触发下也不会再有新的通知，在这里关闭连接
+            errno = savedErrno;
+            LOG_SYSERR << "TcpConnection::handleRead error";
+            handleError();
+            handleClose();
+            return;
+        }
+    }
+    // 边沿触发时预算用完但可能还有数据，不会再有新的通知，排到本轮事件之后继续读
+    if (edgeTriggered && !readResumeQueued_ && state_ != kDisconnected) {
+        readResumeQueued_ = true;
+        loop_->queueInLoop(std::bind(&TcpConnection::resumeRead, shared_from_this()));
+    }
+}
+
+void TcpConnection::handleReadCompletion() {
+    bool eof = false;
     int savedErrno = 0;
-    char buf[65536]; // 64KB buffer
-    ssize_t n = ::read(channel_->fd(), buf, sizeof buf);
-    
+    size_t n = completionPoller_->takeReceived(&channel_, &eof, &savedErrno);
     if (n > 0) {
-        // 读取数据到输入缓冲区
-        inputBuffer_.append(buf, n);
+        Timestamp now(Timestamp::now());
+        lastActive_ = now;
+        Metrics::instance().increment(Metrics::kBytesReceived, static_cast<uint64_t>(n));
+        processInput(now);
+    }
+    if (state_ == kDisconnected) {
+        return;
+    }
+    if (savedErrno != 0) {
+        errno = savedErrno;
+        LOG_SYSERR << "TcpConnection::handleRead error";
+        handleClose();
+    } else if (eof) {
+        handleClose();
+    }
+}
+
+void TcpConnection::processInput(Timestamp now) {
+    // 正在关闭的连接不再处理新请求
+    if (state_ != kConnected) {
+        return;
+    }
+    
+    // 缓冲区中可能有多个流水线请求，逐个处理直到数据不足
+    // 每处理完一个请求，HTTP会话会从inputBuffer_中消费对应的字节
+    // 请求的开始时间：请求头跨多次读取时为开始计时的时间
+    Timestamp requestStart =
+        headerStart_.valid() && httpConnection_.readingHeaders() ? headerStart_ : now;
+    while (true) {
+        HttpRequest::ParseResult result = httpConnection_.process(&inputBuffer_);
+        if (result == HttpRequest::ParseResult::NEED_MORE) {
+            break;
+        }
         
-        // 创建HTTP连接对象并处理请求
-        HttpConnection httpConn(channel_->fd());
-        httpConn.appendBuffer(inputBuffer_);
+        // 无论成功与否都发送响应（失败时为错误页面），响应头和响应体分段发送
+        std::string header, body, trailer;
+        httpConnection_.takeResponse(&header, &body, &trailer);
+        StaticFileCache::EntryPtr content = httpConnection_.takeResponseContent();
+        OpenFileCache::FilePtr file = httpConnection_.takeResponseFile();
+        size_t bytes = header.size();
+        if (content) {
+            bytes += content->size();
+        } else if (file) {
+            bytes += static_cast<size_t>(file->size());
+        } else {
+            bytes += body.size() + trailer.size();
+        }
+        Timestamp finish(Timestamp::now());
+        Metrics::instance().recordRequest(httpConnection_.responseStatus(),
+            finish.microSecondsSinceEpoch() - requestStart.microSecondsSinceEpoch());
+        Metrics::instance().increment(Metrics::kBytesSent, bytes);
+        if (AccessLog::instance().enabled()) {
+            logAccess(requestStart, finish, bytes);
+        }
+        requestStart = now;
+        if (content) {
+            // 缓存中的内容由所有连接共享，只发送引用
+            sendShared(std::move(header), content, content->data(), content->size());
+        } else if (file) {
+            // 静态文件通过sendfile发送，内存占用与文件大小无关；描述符来自打开文件缓存
+            sendFile(std::move(header), file, file->fd(), 0, static_cast<size_t>(file->size()));
+        } else {
+            sendSegments(std::move(header), std::move(body), std::move(trailer));
+        }
         
-        if (httpConn.process()) {
-            // 发送HTTP响应
-            send(httpConn.getResponse());
+        if (httpConnection_.isClose()) {
+            // 短连接、Connection: close或达到请求数上限时，发送完响应后关闭
+            shutdown();
+            break;
         }
         
-        // 发送完响应后关闭连接
-        shutdown();
-    } else if (n == 0) {
-        handleClose();
+        // keep-alive：重置会话状态，等待下一个请求；下一个请求的请求头重新计时
+        headerStart_ = Timestamp();
+        httpConnection_.reset();
+    }
+
+    // 请求头尚未收完时开始计时，收完后清除
+    if (httpConnection_.readingHeaders()) {
+        if (!headerStart_.valid()) {
+            headerStart_ = now;
+            // 请求头超时通常早于已登记的空闲超时，需要提前放入时间轮
+            std::shared_ptr<TimingWheel> wheel(timingWheel_.lock());
+            Timestamp newDeadline = deadline();
+            if (wheel && newDeadline.valid() &&
+                (!scheduledDeadline_.valid() || newDeadline < scheduledDeadline_)) {
+                wheel->schedule(this);
+            }
+        }
     } else {
-        errno = savedErrno;
-        std::cerr << "TcpConnection::handleRead error" << std::endl;
-        handleError();
+        headerStart_ = Timestamp();
     }
 }
 
 void TcpConnection::handleWrite() {
     loop_->assertInLoopThread();
-    if (channel_->isWriting()) {
-        ssize_t n = ::write(channel_->fd(), outputBuffer_.data(), outputBuffer_.size());
-        if (n > 0) {
-            outputBuffer_.erase(0, n);
-            if (outputBuffer_.empty()) {
-                channel_->disableWriting();
-                if (writeCompleteCallback_) {
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if (state_ == kDisconnecting) {
-                    shutdownInLoop();
+    if (state_ != kDisconnected && completionPoller_ != nullptr) {
+        handleWriteCompletion();
+    } else if (state_ != kDisconnected && writing()) {
+        // 水平触发时每次事件写一次；边沿触发时写到EAGAIN或写完为止，但不超过预算
+        const bool edgeTriggered = channel_.edgeTriggered();
+        const int budget = edgeTriggered ? kEdgeTriggeredWriteBudget : 1;
+        for (int i = 0; i < budget && pendingOutputBytes() > 0; ++i) {
+            // 队首是文件数据段时用sendfile续传，否则用writev写出内存数据
+            bool sendingFile = outputBuffer_.readableBytes() == 0 &&
+                               !outputChunks_.empty() && outputChunks_.front().fileFd >= 0;
+            ssize_t n = sendingFile ? writeFileChunk() : writeMemoryChunks();
+            if (n > 0) {
+                lastActive_ = Timestamp::now();
+            } else if (n == 0 && sendingFile) {
+                // 文件在发送过程中被截断，已发出的Content-Length无法兑现，只能关闭连接
+                LOG_ERROR << "TcpConnection::handleWrite file truncated";
+                handleClose();
+                return;
+            } else {
+                if (!edgeTriggered || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    LOG_SYSERR << "TcpConnection::handleWrite error";
                 }
+                // 边沿触发时等待下一次可写通知
+                reportPendingOutput();
+                return;
             }
-        } else {
-            std::cerr << "TcpConnection::handleWrite error" << std::endl;
+        }
+        reportPendingOutput();
+        if (pendingOutputBytes() == 0) {
+            stopWriting();
+            if (callbacks_->writeComplete) {
+                loop_->queueInLoop(
+                    std::bind(callbacks_->writeComplete, shared_from_this()));
+            }
+            if (state_ == kDisconnecting) {
+                shutdownInLoop();
+            }
+        } else if (edgeTriggered && !writeResumeQueued_) {
+            // 预算用完时套接字可能仍可写，不会再有新的通知，排到本轮事件之后继续写
+            writeResumeQueued_ = true;
+            loop_->queueInLoop(std::bind(&TcpConnection::resumeWrite, shared_from_this()));
         }
     } else {
-        std::cerr << "Connection fd = " << channel_->fd()
-                  << " is down, no more writing" << std::endl;
+        LOG_TRACE << "Connection fd = " << channel_.fd()
+                  << " is down, no more writing";
     }
 }
 
+void TcpConnection::handleWriteCompletion() {
+    if (!writing()) {
+        LOG_TRACE << "Connection fd = " << channel_.fd() << " has nothing to write";
+        return;
+    }
+    if (sendInFlight_) {
+        ssize_t n = 0;
+        if (!completionPoller_->takeSendResult(&channel_, &n)) {
+            // 上一次发送请求尚未完成
+            return;
+        }
+        sendInFlight_ = false;
+        if (n > 0) {
+            retrieveOutput(static_cast<size_t>(n));
+            lastActive_ = Timestamp::now();
+        } else if (n < 0) {
+            // 连接被重置等错误，不再提交后续数据
+            errno = static_cast<int>(-n);
+            LOG_SYSERR << "TcpConnection::handleWrite error";
+            reportPendingOutput();
+            handleClose();
+            return;
+        }
+    }
+
+    // sendfile没有对应的io_uring请求，队首是文件数据段时仍同步续传，每次事件一次
+    if (outputBuffer_.readableBytes() == 0 &&
+        !outputChunks_.empty() && outputChunks_.front().fileFd >= 0) {
+        ssize_t n = writeFileChunk();
+        if (n > 0) {
+            lastActive_ = Timestamp::now();
+        } else if (n == 0) {
+            // 文件在发送过程中被截断，已发出的Content-Length无法兑现，只能关闭连接
+            LOG_ERROR << "TcpConnection::handleWrite file truncated";
+            reportPendingOutput();
+            handleClose();
+            return;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_SYSERR << "TcpConnection::handleWrite error";
+        }
+    }
+    if (outputBuffer_.readableBytes() == 0 &&
+        !outputChunks_.empty() && outputChunks_.front().fileFd >= 0) {
+        // 文件未发送完，等待可写事件
+        if (!channel_.isWriting()) {
+            channel_.enableWriting();
+        }
+    } else {
+        if (channel_.isWriting()) {
+            channel_.disableWriting();
+        }
+        if (pendingOutputBytes() > 0) {
+            submitMemoryChunks();
+        }
+    }
+
+    reportPendingOutput();
+    if (!writing()) {
+        if (callbacks_->writeComplete) {
+            loop_->queueInLoop(
+                std::bind(callbacks_->writeComplete, shared_from_this()));
+        }
+        if (state_ == kDisconnecting) {
+            shutdownInLoop();
+        }
+    }
+}
+
+void TcpConnection::submitMemoryChunks() {
+    // 与writeMemoryChunks()相同的聚合方式，请求完成后由handleWriteCompletion()消费已发出的字节
+    if (!sendRequest_) {
+        sendRequest_.reset(new SendRequest);
+    }
+    struct iovec* vec = sendRequest_->vec;
+    int iovcnt = 0;
+    if (outputBuffer_.readableBytes() > 0) {
+        vec[iovcnt].iov_base = const_cast<char*>(outputBuffer_.peek());
+        vec[iovcnt].iov_len = outputBuffer_.readableBytes();
+        ++iovcnt;
+    }
+    for (auto it = outputChunks_.begin();
+         it != outputChunks_.end() && it->fileFd < 0 && iovcnt < kMaxWriteIov; ++it) {
+        vec[iovcnt].iov_base = const_cast<char*>(it->begin() + it->offset);
+        vec[iovcnt].iov_len = it->size() - it->offset;
+        ++iovcnt;
+    }
+    struct msghdr& msg = sendRequest_->msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = iovcnt;
+    // 连接本身作为owner，请求完成前（包括连接关闭后被撤销的请求）数据一直有效
+    if (completionPoller_->submitSend(&channel_, &msg, shared_from_this())) {
+        sendInFlight_ = true;
+    } else {
+        LOG_ERROR << "TcpConnection::submitMemoryChunks - submit send failed, fd = " << channel_.fd();
+    }
+}
+
+void TcpConnection::startWriting() {
+    if (completionPoller_ != nullptr) {
+        // 完成模式：本轮事件处理之后统一提交，同一轮产生的多个响应合并为一个发送请求
+        if (!sendInFlight_ && !writeResumeQueued_) {
+            writeResumeQueued_ = true;
+            loop_->queueInLoop(std::bind(&TcpConnection::resumeWrite, shared_from_this()));
+        }
+    } else if (!channel_.edgeTriggered()) {
+        if (!channel_.isWriting()) {
+            channel_.enableWriting();
+        }
+    } else if (!writeResumeQueued_) {
+        // 可写事件一直开启，但数据未写完不一定是因为发送缓冲区已满（如sendfile的分块），
+        // 此时不会有新的可写通知，排到本轮事件之后再写一次
+        writeResumeQueued_ = true;
+        loop_->queueInLoop(std::bind(&TcpConnection::resumeWrite, shared_from_this()));
+    }
+}
+
+void TcpConnection::stopWriting() {
+    if (!channel_.edgeTriggered()) {
+        channel_.disableWriting();
+    }
+}
+
+void TcpConnection::resumeRead() {
+    readResumeQueued_ = false;
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        handleRead();
+    }
+}
+
+void TcpConnection::resumeWrite() {
+    writeResumeQueued_ = false;
+    handleWrite();
+}
+
 void TcpConnection::handleClose() {
     loop_->assertInLoopThread();
-    std::cout << "fd = " << channel_->fd() << " state = " << state_ << std::endl;
+    LOG_DEBUG << "fd = " << channel_.fd() << " state = " << state_;
     assert(state_ == kConnected || state_ == kDisconnecting);
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
 
     TcpConnectionPtr guardThis(shared_from_this());
-    connectionCallback_(guardThis);
-    closeCallback_(guardThis);
+    if (callbacks_->connection) {
+        callbacks_->connection(guardThis);
+    }
+    if (callbacks_->close) {
+        callbacks_->close(guardThis);
+    }
 }
 
 void TcpConnection::handleError() {
     int optval;
     socklen_t optlen = sizeof optval;
-    if (::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
+    if (::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
         optval = errno;
     }
-    std::cerr << "TcpConnection::handleError [" << name_ << "] - SO_ERROR = "
-              << optval << " " << strerror(optval) << std::endl;
+    LOG_ERROR << "TcpConnection::handleError [" << id_ << "] - SO_ERROR = "
+              << optval << " " << strerror(optval);
 }
\ No newline at end of file
@@ -1,39 +1,113 @@
 #include "tcp_server.h"
-#include <iostream>
+#include "logging.h"
+#include "http_connection.h"
+#include "metrics.h"
 #include <sstream>
 #include <cassert>
+#include <algorithm>
+#include <future>
 
 TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr, 
                    const std::string& nameArg, bool reuseport)
     : loop_(loop),
       name_(nameArg),
       listenAddr_(listenAddr),
+      reuseport_(reuseport),
       acceptor_(new Acceptor(loop, listenAddr, reuseport)),
+      acceptBatch_(Acceptor::kDefaultAcceptBatch),
+      exclusiveAccept_(false),
       threadPool_(new EventLoopThreadPool(loop, nameArg)),
       connectionCallback_(),
       messageCallback_(),
       writeCompleteCallback_(),
       threadInitCallback_(),
       started_(false),
-      nextConnId_(1) {
+      maxKeepAliveRequests_(HttpConnection::kDefaultMaxRequests),
+      idleTimeout_(kDefaultIdleTimeout),
+      headerTimeout_(kDefaultHeaderTimeout),
+      timeoutTick_(1.0),
+      edgeTriggered_(false) {
     // 设置Acceptor的新连接回调
-    acceptor_->setNewConnectionCallback(
-        std::bind(&TcpServer::newConnection, this, 
-                 std::placeholders::_1, std::placeholders::_2));
+    acceptor_->setNewConnectionsCallback(
+        std::bind(&TcpServer::newConnections, this, std::placeholders::_1));
 }
 
 TcpServer::~TcpServer() {
     loop_->assertInLoopThread();
-    std::cout << "TcpServer::~TcpServer [" << name_ << "] destructing" << std::endl;
+    LOG_INFO << "TcpServer::~TcpServer [" << name_ << "] destructing";
 
-    for (auto& item : connections_) {
-        TcpConnection::TcpConnectionPtr conn(item.second);
-        item.second.reset();
-        conn->getLoop()->runInLoop(
-            std::bind(&TcpConnection::connectDestroyed, conn));
+    // 每线程的Acceptor必须在各自的IO线程中销毁，等待销毁完成后再继续
+    for (std::unique_ptr<Acceptor>& acceptor : loopAcceptors_) {
+        Acceptor* raw = acceptor.release();
+        std::shared_ptr<std::promise<void> > done(new std::promise<void>());
+        std::future<void> destroyed = done->get_future();
+        raw->getLoop()->runInLoop([raw, done]() {
+            delete raw;
+            done->set_value();
+        });
+        destroyed.wait();
+    }
+
+    // 各IO线程销毁自己连接表中的连接
+    for (auto& item : loopConnections_) {
+        EventLoop* ioLoop = item.first;
+        std::shared_ptr<std::promise<void> > done(new std::promise<void>());
+        std::future<void> destroyed = done->get_future();
+        ioLoop->runInLoop([this, ioLoop, done]() {
+            destroyLoopConnections(ioLoop);
+            done->set_value();
+        });
+        destroyed.wait();
     }
 }
 
+void TcpServer::destroyLoopConnections(EventLoop* ioLoop) {
+    ioLoop->assertInLoopThread();
+    LoopConnections& connections = *loopConnections_.find(ioLoop)->second;
+    std::vector<ConnectionSlot> slots;
+    slots.swap(connections.slots);
+    connections.freeSlots.clear();
+    connections.count.store(0, std::memory_order_relaxed);
+    for (ConnectionSlot& slot : slots) {
+        if (slot.conn) {
+            slot.conn->connectDestroyed();
+        }
+    }
+
+    // 时间轮通过本对象查找连接，服务器析构后不能再回调
+    auto wheel = timingWheels_.find(ioLoop);
+    if (wheel != timingWheels_.end()) {
+        wheel->second->stop();
+    }
+}
+
+TcpConnection* TcpServer::findConnection(EventLoop* ioLoop, uint64_t id) const {
+    ioLoop->assertInLoopThread();
+    const LoopConnections& connections = *loopConnections_.find(ioLoop)->second;
+    uint32_t index = static_cast<uint32_t>(id);
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (index >= connections.slots.size() || connections.slots[index].generation != generation) {
+        return nullptr;
+    }
+    return connections.slots[index].conn.get();
+}
+
+size_t TcpServer::connectionCount() const {
+    size_t count = 0;
+    for (const auto& item : loopConnections_) {
+        count += item.second->count.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+bool TcpServer::perLoopAcceptors() const {
+    return reuseport_ && threadPool_->threadNum() > 0;
+}
+
+bool TcpServer::sharedAcceptors() const {
+    return !reuseport_ && exclusiveAccept_ && threadPool_->threadNum() > 0;
+}
+
 void TcpServer::setThreadNum(int numThreads) {
     assert(0 <= numThreads);
     threadPool_->setThreadNum(numThreads);
@@ -43,65 +117,178 @@ void TcpServer::start() {
     if (!started_) {
         started_ = true;
         threadPool_->start(threadInitCallback_);
-        assert(!acceptor_->listening());
-        loop_->runInLoop(
-            std::bind(&Acceptor::listen, acceptor_.get()));
+
+        // 回调只生成一份，所有连接共享
+        std::shared_ptr<TcpConnection::Callbacks> callbacks(new TcpConnection::Callbacks());
+        callbacks->connection = connectionCallback_;
+        callbacks->message = messageCallback_;
+        callbacks->writeComplete = writeCompleteCallback_;
+        callbacks->close = std::bind(&TcpServer::removeConnection, this, std::placeholders::_1);
+        connectionCallbacks_ = callbacks;
+
+        for (EventLoop* ioLoop : threadPool_->getAllLoops()) {
+            loopConnections_[ioLoop].reset(new LoopConnections());
+        }
+
+        // 每个IO线程一个时间轮，格子数覆盖最长的超时时间
+        if (idleTimeout_ > 0.0 || headerTimeout_ > 0.0) {
+            double span = std::max(idleTimeout_, headerTimeout_);
+            int numBuckets = std::max(static_cast<int>(span / timeoutTick_) + 2,
+                                      TimingWheel::kDefaultBuckets);
+            for (EventLoop* ioLoop : threadPool_->getAllLoops()) {
+                std::shared_ptr<TimingWheel> wheel(new TimingWheel(
+                    ioLoop,
+                    std::bind(&TcpServer::findConnection, this, ioLoop, std::placeholders::_1),
+                    timeoutTick_, numBuckets));
+                wheel->start();
+                timingWheels_[ioLoop] = wheel;
+            }
+        }
+        if (perLoopAcceptors() || sharedAcceptors()) {
+            // reuseport：每个IO线程各自绑定同一端口，主线程的Acceptor不再需要；
+            // 共享：每个IO线程监听主线程Acceptor绑定的套接字，主线程Acceptor只持有该套接字
+            bool shared = sharedAcceptors();
+            if (!shared) {
+                acceptor_.reset();
+            }
+            for (EventLoop* ioLoop : threadPool_->getAllLoops()) {
+                std::unique_ptr<Acceptor> acceptor(
+                    shared ? new Acceptor(ioLoop, acceptor_->listenFd(), true)
+                           : new Acceptor(ioLoop, listenAddr_, true));
+                acceptor->setAcceptBatch(acceptBatch_);
+                acceptor->setNewConnectionsCallback(
+                    std::bind(&TcpServer::acceptConnections, this, ioLoop,
+                              std::placeholders::_1));
+                ioLoop->runInLoop(
+                    std::bind(&Acceptor::listen, acceptor.get()));
+                loopAcceptors_.push_back(std::move(acceptor));
+            }
+        } else {
+            assert(!acceptor_->listening());
+            acceptor_->setAcceptBatch(acceptBatch_);
+            loop_->runInLoop(
+                std::bind(&Acceptor::listen, acceptor_.get()));
+        }
     }
 }
 
-void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr) {
+void TcpServer::newConnections(const Acceptor::AcceptedConnectionList& accepted) {
     loop_->assertInLoopThread();
+    Metrics::instance().increment(Metrics::kConnectionsAccepted, accepted.size());
     
-    // 为新连接选择一个EventLoop
-    EventLoop* ioLoop = threadPool_->getNextLoop();
-    
-    // 生成连接名称
-    char buf[64];
-    snprintf(buf, sizeof buf, "%s#%d", name_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = buf;
+    // 为每个新连接选择一个EventLoop，按目标EventLoop分组；
+    // 选中时即计入负载，同一批中后面的连接能看到前面的分配结果
+    std::vector<std::pair<EventLoop*, Acceptor::AcceptedConnectionList> > batches;
+    for (const Acceptor::AcceptedConnection& item : accepted) {
+        EventLoop* ioLoop = threadPool_->getNextLoop();
+        ioLoop->connectionAdded();
+        auto it = std::find_if(batches.begin(), batches.end(),
+            [ioLoop](const std::pair<EventLoop*, Acceptor::AcceptedConnectionList>& batch) {
+                return batch.first == ioLoop;
+            });
+        if (it == batches.end()) {
+            batches.push_back(std::make_pair(ioLoop, Acceptor::AcceptedConnectionList()));
+            it = batches.end() - 1;
+        }
+        it->second.push_back(item);
+    }
     
-    std::cout << "TcpServer::newConnection [" << name_ 
-              << "] - new connection [" << connName 
-              << "] from " << peerAddr.toIpPort() << std::endl;
+    // 每个目标IO线程只投递一次（一次唤醒），连接对象在IO线程中创建并登记到该线程的连接表
+    for (auto& batch : batches) {
+        std::shared_ptr<Acceptor::AcceptedConnectionList> items(
+            new Acceptor::AcceptedConnectionList());
+        items->swap(batch.second);
+        EventLoop* ioLoop = batch.first;
+        ioLoop->runInLoop([this, ioLoop, items]() {
+            establishConnections(ioLoop, *items);
+        });
+    }
+}
+
+void TcpServer::acceptConnections(EventLoop* ioLoop,
+                                  const Acceptor::AcceptedConnectionList& accepted) {
+    ioLoop->assertInLoopThread();
+    Metrics::instance().increment(Metrics::kConnectionsAccepted, accepted.size());
+    for (size_t i = 0; i < accepted.size(); ++i) {
+        ioLoop->connectionAdded();
+    }
+    establishConnections(ioLoop, accepted);
+}
+
+void TcpServer::establishConnections(EventLoop* ioLoop,
+                                     const Acceptor::AcceptedConnectionList& accepted) {
+    ioLoop->assertInLoopThread();
+    for (const Acceptor::AcceptedConnection& item : accepted) {
+        createConnection(ioLoop, item.sockfd, item.peerAddr)->connectEstablished();
+    }
+}
+
+TcpConnection::TcpConnectionPtr TcpServer::createConnection(EventLoop* ioLoop, int sockfd,
+                                                            const InetAddress& peerAddr) {
+    ioLoop->assertInLoopThread();
+    LoopConnections& connections = *loopConnections_.find(ioLoop)->second;
+
+    // 分配连接表的槽位，生成连接id
+    uint32_t index;
+    if (connections.freeSlots.empty()) {
+        index = static_cast<uint32_t>(connections.slots.size());
+        ConnectionSlot slot;
+        slot.generation = 1;
+        connections.slots.push_back(slot);
+    } else {
+        index = connections.freeSlots.back();
+        connections.freeSlots.pop_back();
+    }
+    uint64_t id = (static_cast<uint64_t>(connections.slots[index].generation) << 32) | index;
+
+    LOG_DEBUG << "TcpServer::newConnection [" << name_ 
+              << "] - new connection [" << id
+              << "] from " << peerAddr.toIpPort();
     
-    // 创建TcpConnection对象
-    TcpConnection::TcpConnectionPtr conn(
-        new TcpConnection(ioLoop, connName, sockfd, listenAddr_, peerAddr));
+    // 创建TcpConnection对象，对象从ioLoop的对象池中分配
+    TcpConnection::TcpConnectionPtr conn(makeSlabShared<TcpConnection>(
+        connections.pool, ioLoop, id, sockfd, listenAddr_, peerAddr, connectionCallbacks_));
     
     // 记录连接
-    connections_[connName] = conn;
+    connections.slots[index].conn = conn;
+    connections.count.store(connections.count.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
     
-    // 设置回调函数
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-    conn->setCloseCallback(
-        std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
+    conn->setMaxKeepAliveRequests(maxKeepAliveRequests_);
+    conn->setIdleTimeout(idleTimeout_);
+    conn->setHeaderTimeout(headerTimeout_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    auto wheel = timingWheels_.find(ioLoop);
+    if (wheel != timingWheels_.end()) {
+        conn->setTimingWheel(wheel->second);
+    }
     
-    // 在IO线程中建立连接
-    ioLoop->runInLoop(
-        std::bind(&TcpConnection::connectEstablished, conn));
+    return conn;
 }
 
 void TcpServer::removeConnection(const TcpConnection::TcpConnectionPtr& conn) {
-    // 在IO线程中移除连接
-    loop_->runInLoop(
-        std::bind(&TcpServer::removeConnectionInLoop, this, conn));
-}
-
-void TcpServer::removeConnectionInLoop(const TcpConnection::TcpConnectionPtr& conn) {
-    loop_->assertInLoopThread();
+    EventLoop* ioLoop = conn->getLoop();
+    ioLoop->assertInLoopThread();
     
-    std::cout << "TcpServer::removeConnectionInLoop [" << name_ 
-              << "] - connection [" << conn->name() << "]" << std::endl;
+    LOG_DEBUG << "TcpServer::removeConnection [" << name_ 
+              << "] - connection [" << conn->id() << "]";
     
-    // 从映射表中删除
-    size_t n = connections_.erase(conn->name());
-    assert(n == 1);
+    // 从所属IO线程的连接表中删除，不加锁也不经过其他线程；槽位的代数加一后回收
+    LoopConnections& connections = *loopConnections_.find(ioLoop)->second;
+    uint32_t index = static_cast<uint32_t>(conn->id());
+    uint32_t generation = static_cast<uint32_t>(conn->id() >> 32);
+    if (index >= connections.slots.size() || connections.slots[index].generation != generation ||
+        connections.slots[index].conn != conn) {
+        // 不在连接表中说明服务器析构时已经处理过
+        return;
+    }
+    connections.slots[index].conn.reset();
+    ++connections.slots[index].generation;
+    connections.freeSlots.push_back(index);
+    connections.count.store(connections.count.load(std::memory_order_relaxed) - 1,
+                            std::memory_order_relaxed);
     
     // 在IO线程中销毁连接
-    EventLoop* ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn));
 }
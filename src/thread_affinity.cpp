@@ -0,0 +1,117 @@
+#include "thread_affinity.h"
+#include "logging.h"
+#include <fstream>
+#include <set>
+#include <utility>
+#include <cstring>
+#include <cstdlib>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace {
+    // set_mempolicy的模式，与<numaif.h>一致；直接使用系统调用，不依赖libnuma
+    const int kMpolPreferred = 1;
+
+    // 读取sysfs中的整数，失败返回-1
+    int readSysfsInt(const std::string& path) {
+        std::ifstream in(path.c_str());
+        int value = -1;
+        if (!(in >> value)) {
+            return -1;
+        }
+        return value;
+    }
+
+    // 让当前线程优先从node节点分配内存
+    void preferNumaNode(int node) {
+#ifdef SYS_set_mempolicy
+        if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8)) {
+            return;
+        }
+        unsigned long nodemask = 1UL << node;
+        if (::syscall(SYS_set_mempolicy, kMpolPreferred, &nodemask, sizeof(nodemask) * 8 + 1) < 0) {
+            // 内核未开启NUMA时返回ENOSYS，此时本来就只有一个节点
+            if (errno != ENOSYS) {
+                LOG_ERROR << "set_mempolicy error: " << strerror(errno);
+            }
+        }
+#else
+        (void)node;
+#endif
+    }
+}
+
+void setCurrentThreadName(const std::string& name) {
+    // 内核限制线程名最长15个字符（不含结尾的'\0'）
+    std::string shortName = name.substr(0, 15);
+    int ret = ::pthread_setname_np(::pthread_self(), shortName.c_str());
+    if (ret != 0) {
+        LOG_ERROR << "pthread_setname_np error: " << strerror(ret);
+    }
+}
+
+bool bindCurrentThreadToCpu(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        LOG_ERROR << "bindCurrentThreadToCpu: invalid cpu " << cpu;
+        return false;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof cpus, &cpus);
+    if (ret != 0) {
+        LOG_ERROR << "pthread_setaffinity_np(" << cpu << ") error: " << strerror(ret);
+        return false;
+    }
+    preferNumaNode(cpuNumaNode(cpu));
+    return true;
+}
+
+int cpuNumaNode(int cpu) {
+    // /sys/devices/system/cpu/cpuN/目录下有一个nodeX链接
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dp = ::opendir(dir.c_str());
+    if (dp == nullptr) {
+        return -1;
+    }
+    int node = -1;
+    struct dirent* entry;
+    while ((entry = ::readdir(dp)) != nullptr) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    ::closedir(dp);
+    return node;
+}
+
+std::vector<int> physicalCoreCpus() {
+    std::vector<int> result;
+    std::set<std::pair<int, int> > seenCores; // (物理封装, 核心编号)
+
+    // 只考虑当前进程允许运行的CPU（如taskset或容器的限制）
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (::sched_getaffinity(0, sizeof allowed, &allowed) < 0) {
+        return result;
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        int package = readSysfsInt(topology + "physical_package_id");
+        int core = readSysfsInt(topology + "core_id");
+        // 拓扑信息不可用时每个逻辑CPU单独算一个核心
+        if (core < 0 || seenCores.insert(std::make_pair(package, core)).second) {
+            result.push_back(cpu);
+        }
+    }
+    return result;
+}
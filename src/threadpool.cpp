@@ -1,11 +1,15 @@
 #include "threadpool.h"
+#include "thread_affinity.h"
 
 // 构造函数，创建指定数量的线程
-ThreadPool::ThreadPool(size_t threadCount) : stop_(false) {
+ThreadPool::ThreadPool(size_t threadCount, const std::string& name, const std::vector<int>& cpus)
+    : stop_(false),
+      name_(name),
+      cpus_(cpus) {
     // 创建指定数量的工作线程
     workers_.reserve(threadCount);
     for (size_t i = 0; i < threadCount; ++i) {
-        workers_.emplace_back(&ThreadPool::workerThread, this);
+        workers_.emplace_back(&ThreadPool::workerThread, this, i);
     }
 }
 
@@ -29,7 +33,12 @@ ThreadPool::~ThreadPool() {
 }
 
 // 工作线程函数
-void ThreadPool::workerThread() {
+void ThreadPool::workerThread(size_t index) {
+    setCurrentThreadName(name_ + std::to_string(index));
+    if (!cpus_.empty()) {
+        bindCurrentThreadToCpu(cpus_[index % cpus_.size()]);
+    }
+
     while (true) {
         Task task;
         
@@ -0,0 +1,170 @@
+#include "timer_queue.h"
+#include "logging.h"
+#include "event_loop.h"
+#include <cassert>
+#include <cstring>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+std::atomic<int64_t> Timer::s_numCreated_(0);
+
+namespace {
+    // 创建timerfd，使用单调时钟，不受系统时间调整影响
+    int createTimerfd() {
+        int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerfd < 0) {
+            LOG_SYSFATAL << "Failed in timerfd_create";
+        }
+        return timerfd;
+    }
+
+    // 单调时钟的当前时间，与timerfd使用同一时钟
+    Timestamp monotonicNow() {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return Timestamp(static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond
+                         + ts.tv_nsec / 1000);
+    }
+
+    void readTimerfd(int timerfd) {
+        uint64_t howmany;
+        ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+        if (n != sizeof howmany) {
+            LOG_ERROR << "TimerQueue::handleRead() reads " << n << " bytes instead of 8";
+        }
+    }
+
+    void resetTimerfd(int timerfd, Timestamp expiration) {
+        struct itimerspec newValue;
+        memset(&newValue, 0, sizeof newValue);
+        // 按绝对时间设置，已经过去的时间立即触发；全零表示停止，至少设置为1微秒
+        int64_t microseconds = expiration.microSecondsSinceEpoch();
+        if (microseconds < 1) {
+            microseconds = 1;
+        }
+        newValue.it_value.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+        newValue.it_value.tv_nsec =
+            static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+        if (::timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &newValue, nullptr) < 0) {
+            LOG_SYSERR << "timerfd_settime() error";
+        }
+    }
+}
+
+TimerQueue::TimerQueue(EventLoop* loop)
+    : loop_(loop),
+      timerfd_(createTimerfd()),
+      timerfdChannel_(loop, timerfd_),
+      callingExpiredTimers_(false) {
+    timerfdChannel_.setReadCallback(
+        std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue() {
+    timerfdChannel_.disableAll();
+    loop_->removeChannel(&timerfdChannel_);
+    ::close(timerfd_);
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval) {
+    // 系统时间换算为单调时钟：保持when与当前时间的间隔
+    int64_t delay = when.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+    Timestamp expiration(monotonicNow().microSecondsSinceEpoch() + delay);
+    // 序号在调用线程中分配，跨线程添加时调用方也能立即拿到TimerId
+    Timer* timer = new Timer(std::move(cb), expiration, interval, Timer::nextSequence());
+    loop_->runInLoop(
+        std::bind(&TimerQueue::addTimerInLoop, this, timer));
+    return TimerId(timer->sequence());
+}
+
+void TimerQueue::cancel(TimerId timerId) {
+    loop_->runInLoop(
+        std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer* timer) {
+    loop_->assertInLoopThread();
+    Timestamp when = timer->expiration();
+    if (insert(std::unique_ptr<Timer>(timer))) {
+        ::resetTimerfd(timerfd_, when);
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId) {
+    loop_->assertInLoopThread();
+    auto it = timers_.find(timerId.sequence());
+    if (it != timers_.end()) {
+        // 堆中的项留到堆顶时再丢弃，timerfd最多多触发一次
+        timers_.erase(it);
+        compact();
+    } else if (callingExpiredTimers_) {
+        // 正在执行的重复定时器在回调中取消了自己
+        cancelingTimers_.insert(timerId.sequence());
+    }
+}
+
+void TimerQueue::handleRead() {
+    loop_->assertInLoopThread();
+    Timestamp now(monotonicNow());
+    readTimerfd(timerfd_);
+
+    // 取出所有到期的定时器，回调执行期间它们不在定时器表中
+    std::vector<std::unique_ptr<Timer> > expired;
+    while (!heap_.empty() && !(now < heap_.top().first)) {
+        auto it = timers_.find(heap_.top().second);
+        heap_.pop();
+        if (it != timers_.end()) {
+            expired.push_back(std::move(it->second));
+            timers_.erase(it);
+        }
+    }
+
+    callingExpiredTimers_ = true;
+    cancelingTimers_.clear();
+    for (const std::unique_ptr<Timer>& timer : expired) {
+        timer->run();
+    }
+    callingExpiredTimers_ = false;
+
+    // 未被取消的重复定时器重新加入
+    for (std::unique_ptr<Timer>& timer : expired) {
+        if (timer->repeat() && cancelingTimers_.find(timer->sequence()) == cancelingTimers_.end()) {
+            timer->restart(now);
+            insert(std::move(timer));
+        }
+    }
+
+    resetTimerfd();
+}
+
+bool TimerQueue::insert(std::unique_ptr<Timer> timer) {
+    Entry entry(timer->expiration(), timer->sequence());
+    bool earliestChanged = heap_.empty() || entry < heap_.top();
+    heap_.push(entry);
+    timers_[entry.second] = std::move(timer);
+    return earliestChanged;
+}
+
+void TimerQueue::resetTimerfd() {
+    while (!heap_.empty() && timers_.find(heap_.top().second) == timers_.end()) {
+        heap_.pop();
+    }
+    if (!heap_.empty()) {
+        ::resetTimerfd(timerfd_, heap_.top().first);
+    }
+}
+
+void TimerQueue::compact() {
+    // 已取消的项超过一半时重建堆，避免大量取消的远期定时器占用内存
+    if (heap_.size() <= 64 || heap_.size() <= 2 * timers_.size()) {
+        return;
+    }
+    std::vector<Entry> entries;
+    entries.reserve(timers_.size());
+    for (const auto& item : timers_) {
+        entries.push_back(Entry(item.second->expiration(), item.first));
+    }
+    heap_ = TimerHeap(std::greater<Entry>(), std::move(entries));
+}
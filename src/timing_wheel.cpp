@@ -0,0 +1,102 @@
+#include "timing_wheel.h"
+#include "event_loop.h"
+#include "tcp_connection.h"
+#include <cassert>
+
+const int TimingWheel::kDefaultBuckets;
+
+TimingWheel::TimingWheel(EventLoop* loop, const ConnectionResolver& resolver,
+                         double tickSeconds, int numBuckets)
+    : loop_(loop),
+      resolver_(resolver),
+      tickMicroSeconds_(static_cast<int64_t>(tickSeconds * Timestamp::kMicroSecondsPerSecond)),
+      buckets_(numBuckets > 1 ? numBuckets : 2),
+      cursor_(0) {
+    assert(tickMicroSeconds_ > 0);
+}
+
+TimingWheel::~TimingWheel() {
+    if (timerId_.valid()) {
+        loop_->cancel(timerId_);
+    }
+}
+
+void TimingWheel::start() {
+    // 定时器回调只持有弱引用，时间轮析构后残留的回调不做任何事
+    std::weak_ptr<TimingWheel> weakSelf(shared_from_this());
+    double interval = static_cast<double>(tickMicroSeconds_) / Timestamp::kMicroSecondsPerSecond;
+    timerId_ = loop_->runEvery(interval, [weakSelf]() {
+        std::shared_ptr<TimingWheel> self(weakSelf.lock());
+        if (self) {
+            self->onTick();
+        }
+    });
+}
+
+void TimingWheel::stop() {
+    loop_->assertInLoopThread();
+    if (timerId_.valid()) {
+        loop_->cancel(timerId_);
+        timerId_ = TimerId();
+    }
+    for (Bucket& bucket : buckets_) {
+        bucket.clear();
+    }
+    resolver_ = ConnectionResolver();
+}
+
+void TimingWheel::schedule(TcpConnection* conn) {
+    loop_->assertInLoopThread();
+    Timestamp deadline = conn->deadline();
+    if (deadline.valid()) {
+        insert(conn, deadline, Timestamp::now());
+    }
+}
+
+void TimingWheel::insert(TcpConnection* conn, Timestamp deadline, Timestamp now) {
+    int64_t delta = deadline.microSecondsSinceEpoch() - now.microSecondsSinceEpoch();
+    // 向上取整到格子，保证不会早于截止时间检查；超出范围的放入最远的格子
+    int64_t ticks = (delta + tickMicroSeconds_ - 1) / tickMicroSeconds_;
+    int64_t maxTicks = static_cast<int64_t>(buckets_.size()) - 1;
+    if (ticks < 1) {
+        ticks = 1;
+    } else if (ticks > maxTicks) {
+        ticks = maxTicks;
+    }
+
+    Entry entry;
+    entry.connId = conn->id();
+    entry.generation = ++conn->wheelGeneration_;
+    conn->scheduledDeadline_ = deadline;
+    buckets_[(cursor_ + static_cast<size_t>(ticks)) % buckets_.size()].push_back(entry);
+}
+
+void TimingWheel::onTick() {
+    loop_->assertInLoopThread();
+    cursor_ = (cursor_ + 1) % buckets_.size();
+    Bucket expired;
+    expired.swap(buckets_[cursor_]);
+
+    Timestamp now(Timestamp::now());
+    for (const Entry& entry : expired) {
+        TcpConnection* conn = resolver_ ? resolver_(entry.connId) : nullptr;
+        // 连接已移除，或已被重新放入其他格子
+        if (!conn || conn->disconnected() || entry.generation != conn->wheelGeneration_) {
+            continue;
+        }
+        Timestamp deadline = conn->deadline();
+        if (!deadline.valid()) {
+            continue;
+        }
+        if (deadline < now || deadline == now) {
+            conn->forceClose();
+        } else {
+            insert(conn, deadline, now);
+        }
+    }
+    // 保留格子的容量，避免每一轮重新分配
+    expired.clear();
+    if (buckets_[cursor_].empty()) {
+        buckets_[cursor_].swap(expired);
+    }
+}
@@ -0,0 +1,779 @@
+#include "uring_poller.h"
+#include "logging.h"
+#include "channel.h"
+#include "buffer.h"
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#ifdef __has_include
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// 需要多次触发的poll（IORING_POLL_ADD_MULTI）和带超时参数的io_uring_enter（IORING_ENTER_EXT_ARG），
+// 头文件或系统调用号缺失时只保留回退路径
+#if defined(IORING_POLL_ADD_MULTI) && defined(IORING_ENTER_EXT_ARG) && \
+    defined(IORING_FEAT_RSRC_TAGS) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define WEBSERVER_HAVE_IO_URING 1
+#endif
+
+// 完成模式需要多次触发的accept、recv和IORING_REGISTER_PROBE
+#if defined(WEBSERVER_HAVE_IO_URING) && defined(IORING_RECV_MULTISHOT) && \
+    defined(IORING_ACCEPT_MULTISHOT) && defined(__NR_io_uring_register)
+#define WEBSERVER_HAVE_URING_COMPLETIONS 1
+#endif
+
+const unsigned UringPoller::kRingEntries;
+const unsigned UringPoller::kCompletionEntries;
+const size_t UringPoller::kInitChannelTableSize;
+const unsigned UringPoller::kReceiveBufferCount;
+const size_t UringPoller::kReceiveBufferSize;
+
+namespace {
+    // Channel::index()记录Channel是否在表中
+    const int kNew = -1;
+    const int kAdded = 0;
+
+    // 撤销请求自身的完成事件不需要处理
+    const uint64_t kIgnoredUserData = ~static_cast<uint64_t>(0);
+
+    // user_data中代数占24位
+    const uint32_t kGenerationMask = 0xffffff;
+
+    // 接收缓冲区的组号
+    const uint16_t kBufferGroup = 0;
+
+    // 交给poll请求的事件：去掉只对epoll有意义的标志
+    uint32_t pollMask(uint32_t events) {
+        uint32_t mask = events & ~static_cast<uint32_t>(EPOLLET);
+#ifdef EPOLLEXCLUSIVE
+        mask &= ~static_cast<uint32_t>(EPOLLEXCLUSIVE);
+#endif
+        return mask;
+    }
+
+    uint64_t makeUserData(int fd, uint32_t generation, int op) {
+        return (static_cast<uint64_t>(op) << 56) |
+               (static_cast<uint64_t>(generation & kGenerationMask) << 32) |
+               static_cast<uint32_t>(fd);
+    }
+}
+
+UringPoller::Entry::Entry()
+    : channel(nullptr),
+      generation(0),
+      active(false),
+      revents(0),
+      events(0),
+      pollGeneration(0),
+      armed(false),
+      multishot(false),
+      accepting(false),
+      acceptArmed(false),
+      acceptError(0),
+      receiveBuffer(nullptr),
+      receiveArmed(false),
+      received(0),
+      eof(false),
+      receiveError(0),
+      sending(false),
+      sendDone(false),
+      sendResult(0) {
+}
+
+#ifdef WEBSERVER_HAVE_IO_URING
+
+UringPoller* UringPoller::create() {
+    UringPoller* poller = new UringPoller();
+    if (!poller->setup()) {
+        delete poller;
+        return nullptr;
+    }
+    return poller;
+}
+
+#else
+
+UringPoller* UringPoller::create() {
+    return nullptr;
+}
+
+#endif
+
+UringPoller::UringPoller()
+    : ringFd_(-1),
+      sqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      sqHead_(nullptr),
+      sqTail_(nullptr),
+      sqMask_(0),
+      sqEntries_(0),
+      sqes_(nullptr),
+      sqesSize_(0),
+      sqLocalTail_(0),
+      toSubmit_(0),
+      cqRing_(MAP_FAILED),
+      cqRingSize_(0),
+      cqHead_(nullptr),
+      cqTail_(nullptr),
+      cqMask_(0),
+      cqes_(nullptr),
+      receiveBuffers_(nullptr),
+      channels_(kInitChannelTableSize, Entry()) {
+}
+
+UringPoller::~UringPoller() {
+#ifdef WEBSERVER_HAVE_IO_URING
+    // 所有Channel都已移除，等待已撤销的发送请求完成后再释放它们的数据
+    ChannelList ignored;
+    for (int i = 0; i < 10 && !retiredSends_.empty(); ++i) {
+        if (enter(1, 100) < 0 && errno != EINTR && errno != ETIME) {
+            break;
+        }
+        harvest(&ignored);
+    }
+#endif
+    if (!retiredSends_.empty()) {
+        LOG_WARN << "UringPoller::~UringPoller - " << retiredSends_.size()
+                 << " send requests still in flight";
+    }
+    if (ringFd_ >= 0) {
+        ::close(ringFd_);
+        ringFd_ = -1;
+    }
+    if (receiveBuffers_ != nullptr) {
+        ::munmap(receiveBuffers_, kReceiveBufferCount * kReceiveBufferSize);
+    }
+    if (sqes_ != nullptr) {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED) {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+}
+
+#ifdef WEBSERVER_HAVE_IO_URING
+
+bool UringPoller::setup() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kCompletionEntries;
+#if defined(IORING_SETUP_SINGLE_ISSUER) && defined(IORING_SETUP_DEFER_TASKRUN)
+    // 只有所属IO线程提交请求：完成事件推迟到该线程进入io_uring_enter时处理，不打断正在运行的线程
+    params.flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+#endif
+    ringFd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+    if (ringFd_ < 0 && errno == EINVAL) {
+        // 较旧的内核不认识新的标志
+        memset(&params, 0, sizeof params);
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = kCompletionEntries;
+        ringFd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+    }
+    if (ringFd_ < 0) {
+        LOG_SYSERR << "io_uring_setup error";
+        return false;
+    }
+    const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                              IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+    if ((params.features & required) != required) {
+        LOG_WARN << "io_uring lacks required features: 0x" << params.features;
+        return false;
+    }
+
+    // 提交队列和完成队列共用一段映射，提交队列项单独映射
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    cqRingSize_ = sqRingSize_;
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        LOG_SYSERR << "io_uring mmap sq ring error";
+        return false;
+    }
+    cqRing_ = sqRing_;
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_SYSERR << "io_uring mmap sqes error";
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqLocalTail_ = *sqTail_;
+    // 提交队列项与下标一一对应，之后不再修改
+    unsigned* array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries_; ++i) {
+        array[i] = i;
+    }
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    if (!setupReceiveBuffers()) {
+        LOG_INFO << "io_uring multishot recv is not available, using readiness notification only";
+    }
+    return true;
+}
+
+#ifdef WEBSERVER_HAVE_URING_COMPLETIONS
+
+bool UringPoller::setupReceiveBuffers() {
+    // 多次触发的recv与IORING_OP_SEND_ZC同在6.0加入，按后者是否可用判断
+    const unsigned kProbeOps = 256;
+    std::vector<char> probeBuffer(sizeof(struct io_uring_probe) +
+                                  kProbeOps * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(&probeBuffer[0]);
+    if (::syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PROBE, probe, kProbeOps) < 0 ||
+        probe->last_op < IORING_OP_SEND_ZC ||
+        !(probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED)) {
+        return false;
+    }
+
+    void* buffers = ::mmap(nullptr, kReceiveBufferCount * kReceiveBufferSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        LOG_SYSERR << "mmap receive buffers error";
+        return false;
+    }
+    receiveBuffers_ = static_cast<char*>(buffers);
+    // 与第一次等待一起提交
+    provideBuffers(0, kReceiveBufferCount);
+    return true;
+}
+
+void UringPoller::provideBuffers(unsigned bufferId, unsigned count) {
+    // 注册的缓冲区环（IORING_REGISTER_PBUF_RING）在部分内核上注册成功但选取缓冲区总是失败（ENOBUFS），
+    // 这里使用IORING_OP_PROVIDE_BUFFERS，归还请求与其他请求合并提交，不增加系统调用
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(receiveBuffers_ + bufferId * kReceiveBufferSize);
+    sqe->len = static_cast<uint32_t>(kReceiveBufferSize);
+    sqe->off = bufferId;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = kIgnoredUserData;
+}
+
+#else
+
+bool UringPoller::setupReceiveBuffers() { return false; }
+void UringPoller::provideBuffers(unsigned, unsigned) {}
+
+#endif
+
+int UringPoller::poll(int timeoutMs, ChannelList* activeChannels) {
+    // 单次poll已交付的Channel仍关注事件时重新提交
+    for (int fd : rearm_) {
+        Entry& entry = channels_[fd];
+        if (entry.channel != nullptr && !entry.armed && entry.events != 0) {
+            arm(fd, entry);
+        }
+    }
+    rearm_.clear();
+    // 被内核终止的多次触发的accept/recv重新提交（如缓冲区环暂时用完）
+    for (int fd : restart_) {
+        Entry& entry = channels_[fd];
+        if (entry.channel == nullptr) {
+            continue;
+        }
+        if (entry.accepting && !entry.acceptArmed) {
+            armAccept(fd, entry);
+        }
+        if (entry.receiveBuffer != nullptr && !entry.receiveArmed &&
+            !entry.eof && entry.receiveError == 0) {
+            armReceive(fd, entry);
+        }
+    }
+    restart_.clear();
+
+    // 完成队列为空时提交并等待；已有事件时只在有待提交的请求时进入内核，且不等待
+    bool empty = __atomic_load_n(cqHead_, __ATOMIC_RELAXED) ==
+                 __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    if (empty || toSubmit_ > 0) {
+        int ret = enter(empty ? 1 : 0, timeoutMs);
+        if (ret < 0) {
+            int savedErrno = errno;
+            if (savedErrno != EINTR && savedErrno != ETIME && savedErrno != EBUSY) {
+                LOG_SYSERR << "io_uring_enter error";
+            }
+            errno = savedErrno;
+        }
+    }
+    return harvest(activeChannels);
+}
+
+int UringPoller::enter(unsigned minComplete, int timeoutMs) {
+    // 先让内核看到新填写的请求
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void* argp = nullptr;
+    size_t argsz = 0;
+    if (minComplete > 0 && timeoutMs >= 0) {
+        memset(&arg, 0, sizeof arg);
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof arg;
+    }
+    int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit_, minComplete,
+                                         flags, argp, argsz));
+    if (ret >= 0) {
+        toSubmit_ -= std::min(toSubmit_, static_cast<unsigned>(ret));
+    }
+    return ret;
+}
+
+struct io_uring_sqe* UringPoller::getSqe() {
+    if (sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        // 提交队列已满，先提交，不等待
+        if (enter(0, -1) < 0) {
+            LOG_SYSFATAL << "io_uring_enter submit error";
+        }
+    }
+    struct io_uring_sqe* sqe = &sqes_[sqLocalTail_ & sqMask_];
+    memset(sqe, 0, sizeof *sqe);
+    ++sqLocalTail_;
+    ++toSubmit_;
+    return sqe;
+}
+
+void UringPoller::arm(int fd, Entry& entry) {
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = entry.events;
+    sqe->len = entry.multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = makeUserData(fd, entry.pollGeneration, kOpPoll);
+    entry.armed = true;
+}
+
+void UringPoller::disarm(int fd, Entry& entry) {
+    if (entry.armed) {
+        struct io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = makeUserData(fd, entry.pollGeneration, kOpPoll);
+        sqe->user_data = kIgnoredUserData;
+        entry.armed = false;
+    }
+    // 之后到达的旧poll请求的完成事件一律忽略
+    ++entry.pollGeneration;
+}
+
+void UringPoller::cancel(uint64_t userData) {
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = userData;
+    sqe->user_data = kIgnoredUserData;
+}
+
+void UringPoller::activate(int fd, Entry& entry, uint32_t revents) {
+    if (!entry.active) {
+        entry.active = true;
+        entry.revents = revents;
+        activeFds_.push_back(fd);
+    } else {
+        // 一轮中可能交付多次，合并为一次事件
+        entry.revents |= revents;
+    }
+}
+
+int UringPoller::harvest(ChannelList* activeChannels) {
+    unsigned head = __atomic_load_n(cqHead_, __ATOMIC_RELAXED);
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+        if (cqe.user_data == kIgnoredUserData) {
+            continue;
+        }
+        int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+        uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32) & kGenerationMask;
+        Op op = static_cast<Op>(cqe.user_data >> 56);
+        Entry* entry = findEntry(fd);
+        bool current = entry != nullptr && entry->channel != nullptr &&
+                       generation == ((op == kOpPoll ? entry->pollGeneration : entry->generation) &
+                                      kGenerationMask);
+
+        if (op == kOpPoll) {
+            if (!current) {
+                continue;
+            }
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                // 请求已结束（单次poll交付，或多次触发的poll被内核终止），下一次等待前重新提交
+                entry->armed = false;
+                rearm_.push_back(fd);
+            }
+            activate(fd, *entry, cqe.res >= 0 ? static_cast<uint32_t>(cqe.res)
+                                              : static_cast<uint32_t>(EPOLLERR));
+        } else if (current) {
+            uint32_t revents = complete(fd, *entry, op, cqe);
+            if (revents != 0) {
+                activate(fd, *entry, revents);
+            }
+        } else {
+#ifdef WEBSERVER_HAVE_URING_COMPLETIONS
+            // 过期请求的完成事件：归还内核选用的缓冲区、关闭无人接收的连接、释放已撤销的发送请求的数据
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                provideBuffers(cqe.flags >> IORING_CQE_BUFFER_SHIFT, 1);
+            }
+#endif
+            if (op == kOpAccept && cqe.res >= 0) {
+                ::close(cqe.res);
+            } else if (op == kOpSend) {
+                auto it = retiredSends_.find(cqe.user_data);
+                if (it != retiredSends_.end()) {
+                    releasedOwners_.push_back(std::move(it->second));
+                    retiredSends_.erase(it);
+                }
+            }
+        }
+    }
+    __atomic_store_n(cqHead_, tail, __ATOMIC_RELEASE);
+
+    int numEvents = static_cast<int>(activeFds_.size());
+    for (int fd : activeFds_) {
+        Entry& entry = channels_[fd];
+        entry.active = false;
+        entry.channel->set_revents(entry.revents);
+        activeChannels->push_back(entry.channel);
+    }
+    activeFds_.clear();
+    // 发送数据的owner可能是连接本身，读完完成队列后再释放
+    releasedOwners_.clear();
+    return numEvents;
+}
+
+uint32_t UringPoller::complete(int fd, Entry& entry, Op op, const struct io_uring_cqe& cqe) {
+    bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    if (op == kOpAccept) {
+        if (!more) {
+            entry.acceptArmed = false;
+            restart_.push_back(fd);
+        }
+        if (cqe.res >= 0) {
+            entry.accepted.push_back(cqe.res);
+        } else if (cqe.res != -EAGAIN && cqe.res != -ECANCELED) {
+            entry.acceptError = -cqe.res;
+        } else {
+            return 0;
+        }
+        return EPOLLIN;
+    }
+
+    if (op == kOpReceive) {
+#ifdef WEBSERVER_HAVE_URING_COMPLETIONS
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            unsigned bufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            if (cqe.res > 0) {
+                entry.receiveBuffer->append(receiveBuffers_ + bufferId * kReceiveBufferSize,
+                                            static_cast<size_t>(cqe.res));
+                entry.received += static_cast<size_t>(cqe.res);
+            }
+            provideBuffers(bufferId, 1);
+        }
+#endif
+        if (!more) {
+            entry.receiveArmed = false;
+        }
+        if (cqe.res > 0) {
+            if (!more) {
+                restart_.push_back(fd);
+            }
+            return EPOLLIN;
+        }
+        if (cqe.res == 0) {
+            entry.eof = true;
+            return EPOLLIN;
+        }
+        if (cqe.res == -ENOBUFS) {
+            // 接收缓冲区暂时用完：缓冲区在本轮归还，下一次等待前重新提交
+            restart_.push_back(fd);
+            return 0;
+        }
+        if (cqe.res == -ECANCELED) {
+            return 0;
+        }
+        entry.receiveError = -cqe.res;
+        return EPOLLIN;
+    }
+
+    // 发送请求已完成，结果留给Channel的写回调取走
+    entry.sending = false;
+    entry.sendDone = true;
+    entry.sendResult = cqe.res;
+    releasedOwners_.push_back(std::move(entry.sendOwner));
+    entry.sendOwner.reset();
+    return EPOLLOUT;
+}
+
+UringPoller::Entry& UringPoller::attach(Channel* channel) {
+    int fd = channel->fd();
+    if (static_cast<size_t>(fd) >= channels_.size()) {
+        channels_.resize(std::max(channels_.size() * 2, static_cast<size_t>(fd) + 1), Entry());
+    }
+    Entry& entry = channels_[fd];
+    if (channel->index() == kAdded && entry.channel == channel) {
+        return entry;
+    }
+    if (entry.channel != nullptr && entry.channel != channel) {
+        // fd被重用而旧的Channel没有移除：撤销旧的请求，不再访问旧的Channel
+        LOG_WARN << "UringPoller - replacing stale channel for fd: " << fd;
+        detach(fd, entry);
+    }
+    entry.channel = channel;
+    channel->set_index(kAdded);
+    return entry;
+}
+
+void UringPoller::detach(int fd, Entry& entry) {
+    disarm(fd, entry);
+    entry.events = 0;
+    entry.multishot = false;
+    if (entry.acceptArmed) {
+        cancel(makeUserData(fd, entry.generation, kOpAccept));
+    }
+    if (entry.receiveArmed) {
+        cancel(makeUserData(fd, entry.generation, kOpReceive));
+    }
+    if (entry.sending) {
+        // 发送请求撤销后仍可能访问数据，完成之前继续持有owner
+        uint64_t userData = makeUserData(fd, entry.generation, kOpSend);
+        cancel(userData);
+        retiredSends_[userData] = std::move(entry.sendOwner);
+    }
+    // 已接受但没有取走的连接直接关闭
+    for (int connfd : entry.accepted) {
+        ::close(connfd);
+    }
+    entry.accepted.clear();
+    entry.accepting = false;
+    entry.acceptArmed = false;
+    entry.acceptError = 0;
+    entry.receiveBuffer = nullptr;
+    entry.receiveArmed = false;
+    entry.received = 0;
+    entry.eof = false;
+    entry.receiveError = 0;
+    entry.sending = false;
+    entry.sendDone = false;
+    entry.sendResult = 0;
+    entry.sendOwner.reset();
+    entry.channel = nullptr;
+    // 之后到达的旧请求的完成事件一律忽略
+    ++entry.generation;
+}
+
+void UringPoller::updateChannel(Channel* channel) {
+    int fd = channel->fd();
+    if (channel->index() == kNew) {
+        // 还没有关注任何事件，不必登记
+        if (channel->isNoneEvent()) {
+            return;
+        }
+        Entry& entry = attach(channel);
+        apply(fd, entry, channel);
+    } else {
+        Entry* entry = findEntry(fd);
+        if (entry == nullptr || entry->channel != channel) {
+            LOG_WARN << "Warning: Channel mismatch or not found for fd: " << fd;
+            return;
+        }
+        apply(fd, *entry, channel);
+    }
+}
+
+void UringPoller::apply(int fd, Entry& entry, Channel* channel) {
+    uint32_t events = pollMask(channel->events());
+    bool multishot = channel->edgeTriggered();
+    if (events == entry.events && multishot == entry.multishot) {
+        // 与当前的注册相同（单次poll已交付、等待重新提交的也算在内）
+        return;
+    }
+    disarm(fd, entry);
+    entry.events = events;
+    entry.multishot = multishot;
+    if (events != 0) {
+        arm(fd, entry);
+    }
+}
+
+void UringPoller::removeChannel(Channel* channel) {
+    int fd = channel->fd();
+    assert(channel->isNoneEvent());
+    if (channel->index() == kNew) {
+        return;
+    }
+    Entry* entry = findEntry(fd);
+    assert(entry != nullptr && entry->channel == channel);
+    if (entry == nullptr || entry->channel != channel) {
+        LOG_ERROR << "UringPoller::removeChannel - channel not registered for fd: " << fd;
+        channel->set_index(kNew);
+        return;
+    }
+    detach(fd, *entry);
+    channel->set_index(kNew);
+}
+
+bool UringPoller::hasChannel(Channel* channel) {
+    Entry* entry = findEntry(channel->fd());
+    return entry != nullptr && entry->channel == channel;
+}
+
+#ifdef WEBSERVER_HAVE_URING_COMPLETIONS
+
+void UringPoller::armAccept(int fd, Entry& entry) {
+    // 多次触发的accept不能可靠地返回对端地址（同一块地址缓冲区会被后续连接覆盖），由调用方获取
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = makeUserData(fd, entry.generation, kOpAccept);
+    entry.acceptArmed = true;
+}
+
+void UringPoller::armReceive(int fd, Entry& entry) {
+    // 不指定缓冲区，内核在数据到达时从提供的缓冲区中选择一块
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = makeUserData(fd, entry.generation, kOpReceive);
+    entry.receiveArmed = true;
+}
+
+bool UringPoller::startAccepting(Channel* channel) {
+    if (!supportsCompletions()) {
+        return false;
+    }
+    Entry& entry = attach(channel);
+    entry.accepting = true;
+    if (!entry.acceptArmed) {
+        armAccept(channel->fd(), entry);
+    }
+    return true;
+}
+
+int UringPoller::takeAccepted(Channel* channel, std::vector<int>* fds) {
+    Entry* entry = findEntry(channel->fd());
+    if (entry == nullptr || entry->channel != channel) {
+        return 0;
+    }
+    fds->insert(fds->end(), entry->accepted.begin(), entry->accepted.end());
+    entry->accepted.clear();
+    int error = entry->acceptError;
+    entry->acceptError = 0;
+    return error;
+}
+
+bool UringPoller::startReceiving(Channel* channel, Buffer* buffer) {
+    if (!supportsCompletions()) {
+        return false;
+    }
+    Entry& entry = attach(channel);
+    entry.receiveBuffer = buffer;
+    if (!entry.receiveArmed) {
+        armReceive(channel->fd(), entry);
+    }
+    return true;
+}
+
+size_t UringPoller::takeReceived(Channel* channel, bool* eof, int* error) {
+    Entry* entry = findEntry(channel->fd());
+    if (entry == nullptr || entry->channel != channel) {
+        return 0;
+    }
+    size_t received = entry->received;
+    entry->received = 0;
+    *eof = entry->eof;
+    *error = entry->receiveError;
+    return received;
+}
+
+bool UringPoller::submitSend(Channel* channel, const struct msghdr* msg,
+                             const std::shared_ptr<void>& owner) {
+    Entry* entry = findEntry(channel->fd());
+    if (entry == nullptr || entry->channel != channel || entry->sending) {
+        return false;
+    }
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = channel->fd();
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = makeUserData(channel->fd(), entry->generation, kOpSend);
+    entry->sending = true;
+    entry->sendDone = false;
+    entry->sendOwner = owner;
+    return true;
+}
+
+bool UringPoller::takeSendResult(Channel* channel, ssize_t* result) {
+    Entry* entry = findEntry(channel->fd());
+    if (entry == nullptr || entry->channel != channel || !entry->sendDone) {
+        return false;
+    }
+    entry->sendDone = false;
+    *result = entry->sendResult;
+    return true;
+}
+
+#else
+
+void UringPoller::armAccept(int, Entry&) {}
+void UringPoller::armReceive(int, Entry&) {}
+bool UringPoller::startAccepting(Channel*) { return false; }
+int UringPoller::takeAccepted(Channel*, std::vector<int>*) { return 0; }
+bool UringPoller::startReceiving(Channel*, Buffer*) { return false; }
+size_t UringPoller::takeReceived(Channel*, bool*, int*) { return 0; }
+bool UringPoller::submitSend(Channel*, const struct msghdr*, const std::shared_ptr<void>&) { return false; }
+bool UringPoller::takeSendResult(Channel*, ssize_t*) { return false; }
+
+#endif
+
+#else
+
+bool UringPoller::setup() { return false; }
+int UringPoller::poll(int, ChannelList*) { return 0; }
+void UringPoller::updateChannel(Channel*) {}
+void UringPoller::removeChannel(Channel*) {}
+bool UringPoller::hasChannel(Channel*) { return false; }
+bool UringPoller::startAccepting(Channel*) { return false; }
+int UringPoller::takeAccepted(Channel*, std::vector<int>*) { return 0; }
+bool UringPoller::startReceiving(Channel*, Buffer*) { return false; }
+size_t UringPoller::takeReceived(Channel*, bool*, int*) { return 0; }
+bool UringPoller::submitSend(Channel*, const struct msghdr*, const std::shared_ptr<void>&) { return false; }
+bool UringPoller::takeSendResult(Channel*, ssize_t*) { return false; }
+
+#endif